@@ -0,0 +1,23 @@
+#ifndef SUCCADE_BENCH_H
+#define SUCCADE_BENCH_H
+
+#include <stdint.h>  // int64_t
+#include <time.h>    // clock_gettime(), CLOCK_MONOTONIC
+
+/*
+ * Minimal helpers for the benchmarks: every benchmark is a program of its 
+ * own, built and run by bench/run, that prints its results to stdout.
+ */
+
+// nanoseconds on the monotonic clock
+static int64_t bench_now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// keeps the compiler from optimizing away results that aren't used
+static volatile uintptr_t bench_sink;
+
+#endif
@@ -0,0 +1,124 @@
+#define KITA_IMPLEMENTATION
+#define _GNU_SOURCE
+
+#include <stdio.h>   // printf()
+#include <stdlib.h>  // NULL, size_t
+#include "../src/libkita.h"
+#include "bench.h"
+
+/*
+ * Looking up tracked children by PID and by file descriptor, as done for
+ * every reaped child and every epoll event: the pid hash table and the fd
+ * table against the linear scan over all children that they replaced.
+ */
+
+#define LOOKUPS 1000000
+
+// how children used to be found by PID
+static kita_child_s *scan_pid(kita_state_s *state, pid_t pid)
+{
+	for (size_t i = 0; i < state->cap_children; ++i)
+	{
+		kita_child_s *child = state->children[i];
+		if (child && child->pid == pid)
+		{
+			return child;
+		}
+	}
+	return NULL;
+}
+
+// how children used to be found by file descriptor
+static kita_child_s *scan_fd(kita_state_s *state, int fd)
+{
+	for (size_t i = 0; i < state->cap_children; ++i)
+	{
+		kita_child_s *child = state->children[i];
+		for (int s = 0; child && s < 3; ++s)
+		{
+			if (child->io[s] && child->io[s]->fd == fd)
+			{
+				return child;
+			}
+		}
+	}
+	return NULL;
+}
+
+// adds `num` children with made-up PIDs and fds, as if they were running
+static kita_state_s *make_state(size_t num)
+{
+	kita_state_s *state = kita_init();
+	for (size_t i = 0; i < num; ++i)
+	{
+		kita_child_s *child = kita_child_new("true", 0, 1, 1);
+		kita_child_add(state, child);
+		child->pid = 100000 + i * 7;
+		child->io[KITA_IOS_OUT]->fd = 1000 + i * 2;
+		child->io[KITA_IOS_ERR]->fd = 1000 + i * 2 + 1;
+		libkita_pids_put(state, child);
+		libkita_fds_set(state, child->io[KITA_IOS_OUT]->fd, child);
+		libkita_fds_set(state, child->io[KITA_IOS_ERR]->fd, child);
+	}
+	return state;
+}
+
+static void free_state(kita_state_s *state)
+{
+	for (size_t i = 0; i < state->cap_children; ++i)
+	{
+		kita_child_s *child = state->children[i];
+		for (int s = 0; child && s < 3; ++s)
+		{
+			if (child->io[s])
+			{
+				child->io[s]->fd = -1; // made up, nothing to close
+			}
+		}
+	}
+	kita_free(&state);
+}
+
+static void bench(size_t num)
+{
+	kita_state_s *state = make_state(num);
+	int64_t t[5];
+
+	t[0] = bench_now();
+	for (size_t i = 0; i < LOOKUPS; ++i)
+	{
+		bench_sink ^= (uintptr_t) libkita_child_get_by_pid(state, 100000 + (i % num) * 7);
+	}
+	t[1] = bench_now();
+	for (size_t i = 0; i < LOOKUPS; ++i)
+	{
+		bench_sink ^= (uintptr_t) scan_pid(state, 100000 + (i % num) * 7);
+	}
+	t[2] = bench_now();
+	for (size_t i = 0; i < LOOKUPS; ++i)
+	{
+		bench_sink ^= (uintptr_t) libkita_child_get_by_fd(state, 1000 + (i % (num * 2)));
+	}
+	t[3] = bench_now();
+	for (size_t i = 0; i < LOOKUPS; ++i)
+	{
+		bench_sink ^= (uintptr_t) scan_fd(state, 1000 + (i % (num * 2)));
+	}
+	t[4] = bench_now();
+
+	printf("%5zu children: by pid %6.1f ns (scan %8.1f ns), by fd %6.1f ns (scan %8.1f ns)\n", 
+			num, (double) (t[1] - t[0]) / LOOKUPS, (double) (t[2] - t[1]) / LOOKUPS,
+			(double) (t[3] - t[2]) / LOOKUPS, (double) (t[4] - t[3]) / LOOKUPS);
+
+	free_state(state);
+}
+
+int main()
+{
+	size_t sizes[] = { 8, 32, 128, 512, 2048 };
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i)
+	{
+		bench(sizes[i]);
+	}
+	return 0;
+}
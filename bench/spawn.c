@@ -0,0 +1,82 @@
+#define KITA_IMPLEMENTATION
+#define _GNU_SOURCE
+
+#include <stdio.h>   // printf()
+#include <stdlib.h>  // NULL, size_t, strtoul()
+#include <string.h>  // memset()
+#include <sys/mman.h> // mmap(), madvise(), munmap()
+#include "../src/libkita.h"
+#include "bench.h"
+
+/*
+ * Creating a child process with each of libkita's spawn backends, for a
+ * small process like us and again after we've grown: the time until the
+ * spawn call returns, which is what the main loop pays for, and the time
+ * until the child has run `true` and has been waited for.
+ */
+
+#define SPAWNS 100
+
+static const char *names[] = { "fork", "vfork", "clone", "posix_spawn" };
+
+static void bench(kita_child_s *child, kita_spawn_type_e spawn, size_t mb)
+{
+	int64_t call = 0;
+	int64_t done = 0;
+	for (int i = 0; i < SPAWNS; ++i)
+	{
+		int64_t t0 = bench_now();
+		pid_t pid = libkita_child_popen(child, spawn);
+		int64_t t1 = bench_now();
+		if (pid == -1)
+		{
+			printf("%-12s failed\n", names[spawn]);
+			return;
+		}
+		close(child->io[KITA_IOS_OUT]->fd);
+		child->io[KITA_IOS_OUT]->fd = -1;
+		waitpid(pid, NULL, 0);
+		int64_t t2 = bench_now();
+
+		call += t1 - t0;
+		done += t2 - t0;
+	}
+	printf("%-12s %4zu MiB: spawn %8.1f us, until reaped %8.1f us\n", names[spawn], mb,
+			(double) call / SPAWNS / 1000, (double) done / SPAWNS / 1000);
+}
+
+int main(int argc, char **argv)
+{
+	// how much memory to grow by for the second round, in MiB
+	size_t mb = argc > 1 ? strtoul(argv[1], NULL, 10) : 256;
+
+	kita_child_s *child = kita_child_new("true", 0, 1, 0);
+	if (child == NULL || libkita_child_resolve(child) == -1)
+	{
+		fprintf(stderr, "can't find 'true'\n");
+		return 1;
+	}
+
+	for (int spawn = KITA_SPAWN_FORK; spawn <= KITA_SPAWN_POSIX; ++spawn)
+	{
+		bench(child, spawn, 0);
+	}
+
+	// touch every page, so it has to be mapped in the children, too; no
+	// huge pages, our heap doesn't get those either
+	size_t len = mb << 20;
+	char *mem = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mem != MAP_FAILED)
+	{
+		madvise(mem, len, MADV_NOHUGEPAGE);
+		memset(mem, 1, len);
+		for (int spawn = KITA_SPAWN_FORK; spawn <= KITA_SPAWN_POSIX; ++spawn)
+		{
+			bench(child, spawn, mb);
+		}
+		munmap(mem, len);
+	}
+
+	kita_child_free(&child);
+	return 0;
+}
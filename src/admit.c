@@ -0,0 +1,189 @@
+#include <stdlib.h>    // NULL, size_t
+#include <stdint.h>    // int64_t
+#include "succade.h"   // admit_s, thing_s
+
+/*
+ * Admission control for block processes: at most `max_running` block runs
+ * may go on at once, and new processes may only be created at `rate` per
+ * second, with up to `burst` of them in a row (token bucket). Blocks that
+ * can't be run yet wait in one FIFO queue per priority; the queues are
+ * linked lists running through the blocks themselves, so no allocation is
+ * needed. A limit of 0 means there is no such limit.
+ */
+
+/*
+ * Sets up admission control with the given limits.
+ */
+void admit_init(admit_s *admit, int max_running, double rate, int burst)
+{
+	*admit = (admit_s) { 0 };
+	admit->max_running = max_running > 0 ? max_running : 0;
+	admit->rate        = rate > 0.0 ? rate : 0.0;
+	admit->burst       = burst > 1 ? burst : 1;
+	admit->tokens      = admit->burst;
+}
+
+/*
+ * Adds the tokens that have accumulated since the last refill.
+ */
+static void admit_refill(admit_s *admit, int64_t now)
+{
+	if (admit->rate == 0.0)
+	{
+		return;
+	}
+	if (admit->refilled && now > admit->refilled)
+	{
+		admit->tokens += admit->rate * (now - admit->refilled) / NANOSEC_PER_SEC;
+		if (admit->tokens > admit->burst)
+		{
+			admit->tokens = admit->burst;
+		}
+	}
+	admit->refilled = now;
+}
+
+/*
+ * Returns 1 if a new process may be created right now, otherwise 0.
+ */
+int admit_can_spawn(admit_s *admit, int64_t now)
+{
+	admit_refill(admit, now);
+
+	if (admit->max_running && admit->running >= admit->max_running)
+	{
+		return 0;
+	}
+	return admit->rate == 0.0 || admit->tokens >= 1.0;
+}
+
+/*
+ * Notes that a new process has been created, using up one token. If `slot`
+ * is set, the process also counts towards the running processes until
+ * admit_done() is called for it.
+ */
+void admit_spawned(admit_s *admit, int slot, int64_t now)
+{
+	admit_refill(admit, now);
+
+	if (admit->rate > 0.0)
+	{
+		admit->tokens -= 1.0;
+	}
+	if (slot)
+	{
+		++admit->running;
+	}
+}
+
+/*
+ * Notes that a process that took up a slot has ended.
+ */
+void admit_done(admit_s *admit)
+{
+	if (admit->running > 0)
+	{
+		--admit->running;
+	}
+}
+
+/*
+ * Returns the time at which the next token will be available, which is
+ * `now` if there already is one, or -1 if the spawn rate isn't limited.
+ */
+int64_t admit_next_token(admit_s *admit, int64_t now)
+{
+	if (admit->rate == 0.0)
+	{
+		return -1;
+	}
+
+	admit_refill(admit, now);
+	if (admit->tokens >= 1.0)
+	{
+		return now;
+	}
+	return now + (int64_t) ((1.0 - admit->tokens) / admit->rate * NANOSEC_PER_SEC) + 1;
+}
+
+/*
+ * Returns 1 if any block is queued with the given or a higher priority
+ * (lower number), otherwise 0.
+ */
+int admit_waiting(const admit_s *admit, admit_prio_e prio)
+{
+	for (admit_prio_e p = ADMIT_PRIO_URGENT; p <= prio && p < ADMIT_PRIO_COUNT; ++p)
+	{
+		if (admit->head[p])
+		{
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Queues the block with the given priority, unless it is queued already.
+ */
+void admit_push(admit_s *admit, thing_s *block, admit_prio_e prio, int64_t now)
+{
+	if (block->queued)
+	{
+		return;
+	}
+
+	block->queued = now ? now : 1;
+	block->queue_next = NULL;
+	block->queue_prio = prio;
+
+	if (admit->tail[prio])
+	{
+		admit->tail[prio]->queue_next = block;
+	}
+	else
+	{
+		admit->head[prio] = block;
+	}
+	admit->tail[prio] = block;
+	++admit->num_queued;
+}
+
+/*
+ * Returns the block that should be run next, without removing it from the
+ * queue: the one that has been waiting longest among those with the highest
+ * priority. Returns NULL if no block is queued.
+ */
+thing_s *admit_peek(const admit_s *admit)
+{
+	for (admit_prio_e p = ADMIT_PRIO_URGENT; p < ADMIT_PRIO_COUNT; ++p)
+	{
+		if (admit->head[p])
+		{
+			return admit->head[p];
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Removes the block returned by admit_peek() from its queue.
+ */
+void admit_pop(admit_s *admit)
+{
+	thing_s *block = admit_peek(admit);
+	if (block == NULL)
+	{
+		return;
+	}
+
+	admit_prio_e prio = block->queue_prio;
+	admit->head[prio] = block->queue_next;
+	if (admit->head[prio] == NULL)
+	{
+		admit->tail[prio] = NULL;
+	}
+
+	block->queue_next = NULL;
+	block->queued = 0;
+	--admit->num_queued;
+}
@@ -0,0 +1,49 @@
+#include <stdlib.h>    // NULL, size_t
+#include <string.h>    // strncmp(), strlen()
+#include "succade.h"   // builtin_s
+
+/*
+ * Built-in blocks are rendered by succade itself, without running a child
+ * process, for information that is cheap to get, but would otherwise cost a
+ * fork and exec (or several) on every update. A block uses a built-in by
+ * setting its command to 'builtin:<name>'.
+ */
+
+static const builtin_s builtins[] =
+{
+	{ "clock",   clock_open,   clock_update,   clock_close,   NULL          },
+	{ "cpu",     cpu_open,     cpu_update,     cpu_close,     NULL          },
+	{ "memory",  memory_open,  memory_update,  memory_close,  NULL          },
+	{ "battery", battery_open, battery_update, battery_close, battery_event },
+	{ "network", network_open, network_update, network_close, network_event },
+};
+
+/*
+ * Returns 1 if the given command refers to a built-in, otherwise 0.
+ */
+int is_builtin(const char *cmd)
+{
+	return cmd && strncmp(cmd, BUILTIN_PREFIX, strlen(BUILTIN_PREFIX)) == 0;
+}
+
+/*
+ * Returns the built-in the given command refers to, or NULL if there is no
+ * built-in by that name (or if the command doesn't refer to a built-in).
+ */
+const builtin_s *get_builtin(const char *cmd)
+{
+	if (!is_builtin(cmd))
+	{
+		return NULL;
+	}
+
+	const char *name = cmd + strlen(BUILTIN_PREFIX);
+	for (size_t i = 0; i < sizeof(builtins) / sizeof(builtins[0]); ++i)
+	{
+		if (equals(builtins[i].name, name))
+		{
+			return &builtins[i];
+		}
+	}
+	return NULL;
+}
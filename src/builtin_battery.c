@@ -0,0 +1,340 @@
+#include <stdlib.h>    // NULL, size_t, malloc(), free()
+#include <stdio.h>     // snprintf()
+#include <string.h>    // strcmp(), strncmp(), strlen(), strcpy()
+#include <stdint.h>    // int64_t
+#include <dirent.h>    // opendir(), readdir(), closedir()
+#include <fcntl.h>     // open(), O_RDONLY, O_CLOEXEC
+#include <unistd.h>    // close()
+#include <sys/socket.h>      // socket(), bind(), recvfrom()
+#include <linux/netlink.h>   // sockaddr_nl, NETLINK_KOBJECT_UEVENT
+#include "succade.h"   // thing_s, builtin_s
+
+/*
+ * Built-in battery and AC status: instead of polling the power supply class
+ * in sysfs, listens for the kernel's uevents and only reads the battery's
+ * capacity and status again once the kernel announces that a power supply
+ * has changed, so plugging or unplugging the AC adapter shows right away.
+ * Some batteries don't announce every change of their capacity, so it will
+ * be read again every `interval` seconds (or every minute) anyway. The
+ * format can use the placeholders {capacity} for the capacity in percent,
+ * {status} for the battery's status, as given by the kernel ('Charging',
+ * 'Discharging', 'Full', ...) and {ac}, which is 'AC' while on AC power and
+ * empty otherwise. The first battery (by name) is used.
+ */
+
+struct battery_data
+{
+	int           sock;      // netlink socket for uevents, -1 if we poll
+	int           capacity;  // battery's capacity file
+	int           status;    // battery's status file
+	int           online;    // AC adapter's online file, -1 if there is none
+	int           rescan;    // power supplies were added or removed?
+	const char   *format;    // format, owned by the block's config
+	kita_state_s *kita;      // kita state the socket is watched by
+	char          buf[BUFFER_UEVENT];
+};
+
+/*
+ * Reads the given attribute of the given power supply into `buf`, without
+ * the trailing newline. Returns the number of bytes read, -1 on error.
+ */
+static ssize_t battery_attr(const char *supply, const char *attr, char *buf, size_t len)
+{
+	char path[256];
+	snprintf(path, sizeof(path), "%s/%s/%s", BATTERY_SYSFS, supply, attr);
+
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+	{
+		return -1;
+	}
+	ssize_t n = read_fd(fd, buf, len);
+	close(fd);
+
+	if (n > 0 && buf[n - 1] == '\n')
+	{
+		buf[--n] = '\0';
+	}
+	return n;
+}
+
+/*
+ * Opens the given attribute of the given power supply. Returns the file
+ * descriptor, -1 on error.
+ */
+static int battery_open_attr(const char *supply, const char *attr)
+{
+	char path[256];
+	snprintf(path, sizeof(path), "%s/%s/%s", BATTERY_SYSFS, supply, attr);
+	return open(path, O_RDONLY | O_CLOEXEC);
+}
+
+/*
+ * Closes the files of the battery and AC adapter, if any.
+ */
+static void battery_forget(struct battery_data *bat)
+{
+	int *fds[] = { &bat->capacity, &bat->status, &bat->online };
+	for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); ++i)
+	{
+		if (*fds[i] != -1)
+		{
+			close(*fds[i]);
+			*fds[i] = -1;
+		}
+	}
+}
+
+/*
+ * Finds the first battery and AC adapter (by name) and opens the files we
+ * read on every update. Batteries of devices, like a wireless mouse, are
+ * ignored. Returns 0 if a battery was found, otherwise -1.
+ */
+static int battery_scan(struct battery_data *bat)
+{
+	battery_forget(bat);
+	bat->rescan = 0;
+
+	DIR *dir = opendir(BATTERY_SYSFS);
+	if (dir == NULL)
+	{
+		return -1;
+	}
+
+	char battery[128] = { 0 };
+	char mains[128]   = { 0 };
+	char val[32];
+
+	struct dirent *entry;
+	while ((entry = readdir(dir)))
+	{
+		const char *name = entry->d_name;
+		if (name[0] == '.' || strlen(name) >= sizeof(battery))
+		{
+			continue;
+		}
+		if (battery_attr(name, "type", val, sizeof(val)) <= 0)
+		{
+			continue;
+		}
+
+		if (equals(val, "Battery"))
+		{
+			if (battery_attr(name, "scope", val, sizeof(val)) > 0 && equals(val, "Device"))
+			{
+				continue;
+			}
+			if (battery[0] == '\0' || strcmp(name, battery) < 0)
+			{
+				strcpy(battery, name);
+			}
+		}
+		else if (equals(val, "Mains"))
+		{
+			if (mains[0] == '\0' || strcmp(name, mains) < 0)
+			{
+				strcpy(mains, name);
+			}
+		}
+	}
+	closedir(dir);
+
+	if (battery[0])
+	{
+		bat->capacity = battery_open_attr(battery, "capacity");
+		bat->status   = battery_open_attr(battery, "status");
+	}
+	if (mains[0])
+	{
+		bat->online   = battery_open_attr(mains, "online");
+	}
+	return bat->capacity == -1 ? -1 : 0;
+}
+
+/*
+ * Reads the given file, which has been opened before, into `buf`, without
+ * the trailing newline. Leaves `buf` empty if that fails.
+ */
+static void battery_read(int fd, char *buf, size_t len)
+{
+	buf[0] = '\0';
+	ssize_t n = fd == -1 ? -1 : read_fd(fd, buf, len);
+	if (n > 0 && buf[n - 1] == '\n')
+	{
+		buf[n - 1] = '\0';
+	}
+}
+
+/*
+ * Opens a netlink socket that gets the kernel's uevents. Returns the socket,
+ * -1 on error.
+ */
+static int battery_uevents()
+{
+	int sock = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+			NETLINK_KOBJECT_UEVENT);
+	if (sock == -1)
+	{
+		return -1;
+	}
+
+	// group 1 gets the uevents straight from the kernel (2 is udev's)
+	struct sockaddr_nl addr = { .nl_family = AF_NETLINK, .nl_groups = 1 };
+	if (bind(sock, (struct sockaddr*) &addr, sizeof(addr)) == -1)
+	{
+		close(sock);
+		return -1;
+	}
+	return sock;
+}
+
+struct battery_values
+{
+	char capacity[16];
+	char status[32];
+	char online[8];
+};
+
+static int battery_lookup(const char *name, size_t name_len, char *val, size_t val_len, void *data)
+{
+	struct battery_values *values = data;
+
+	if (name_len == 8 && strncmp(name, "capacity", 8) == 0)
+	{
+		snprintf(val, val_len, "%s", values->capacity);
+		return 0;
+	}
+	if (name_len == 6 && strncmp(name, "status", 6) == 0)
+	{
+		snprintf(val, val_len, "%s", values->status);
+		return 0;
+	}
+	if (name_len == 2 && strncmp(name, "ac", 2) == 0)
+	{
+		snprintf(val, val_len, "%s", equals(values->online, "1") ? "AC" : "");
+		return 0;
+	}
+	return -1;
+}
+
+void battery_close(thing_s *block)
+{
+	struct battery_data *bat = block->data;
+	if (bat == NULL)
+	{
+		return;
+	}
+
+	if (bat->sock != -1)
+	{
+		kita_unwatch_fd(bat->kita, bat->sock);
+		close(bat->sock);
+	}
+	battery_forget(bat);
+	free(bat);
+	block->data = NULL;
+}
+
+int battery_open(state_s *state, thing_s *block)
+{
+	struct battery_data *bat = malloc(sizeof(struct battery_data));
+	if (bat == NULL)
+	{
+		return -1;
+	}
+
+	bat->capacity = bat->status = bat->online = -1;
+	bat->kita = state->kita;
+	bat->format = cfg_get_str(&block->cfg, BLOCK_OPT_FORMAT);
+	if (empty(bat->format))
+	{
+		bat->format = DEFAULT_BATTERY_FORMAT;
+	}
+
+	// without uevents, we'll have to poll, like a script would
+	bat->sock = battery_uevents();
+	if (bat->sock != -1 && kita_watch_fd(state->kita, bat->sock, block) == -1)
+	{
+		close(bat->sock);
+		bat->sock = -1;
+	}
+
+	block->data = bat;
+	if (battery_scan(bat) == -1)
+	{
+		battery_close(block);
+		return -1;
+	}
+	return 0;
+}
+
+int64_t battery_update(state_s *state, thing_s *block, int64_t now, char *buf, size_t len)
+{
+	struct battery_data *bat = block->data;
+	struct battery_values values;
+
+	// the battery might have been swapped, or the files might be gone
+	if (bat->rescan)
+	{
+		battery_scan(bat);
+	}
+	battery_read(bat->capacity, values.capacity, sizeof(values.capacity));
+	if (values.capacity[0] == '\0')
+	{
+		battery_scan(bat);
+		battery_read(bat->capacity, values.capacity, sizeof(values.capacity));
+	}
+	battery_read(bat->status, values.status, sizeof(values.status));
+	battery_read(bat->online, values.online, sizeof(values.online));
+
+	fill_template(buf, len, bat->format, battery_lookup, &values);
+
+	// with uevents, we only poll for changes of the capacity, and rarely so
+	if (bat->sock == -1 || cfg_get_float(&block->cfg, BLOCK_OPT_RELOAD) > 0)
+	{
+		return 0;
+	}
+	return now + DEFAULT_BATTERY_POLL * NANOSEC_PER_SEC;
+}
+
+/*
+ * Reads all uevents that came in, returns 1 if any of them was about a power
+ * supply, otherwise 0. Uevents are a line with the action and device path,
+ * followed by KEY=value pairs, all of them null-terminated.
+ */
+int battery_event(state_s *state, thing_s *block, int fd)
+{
+	struct battery_data *bat = block->data;
+	int changed = 0;
+
+	struct sockaddr_nl addr;
+	socklen_t addr_len = sizeof(addr);
+	ssize_t n;
+	while ((n = recvfrom(fd, bat->buf, sizeof(bat->buf) - 1, 0,
+					(struct sockaddr*) &addr, &addr_len)) > 0)
+	{
+		// only the kernel gets to tell us about its devices
+		if (addr.nl_pid != 0)
+		{
+			continue;
+		}
+		bat->buf[n] = '\0';
+
+		int power = 0;
+		int added = 0;
+		for (char *c = bat->buf; c < bat->buf + n; c += strlen(c) + 1)
+		{
+			if (equals(c, "SUBSYSTEM=power_supply"))
+			{
+				power = 1;
+			}
+			else if (equals(c, "ACTION=add") || equals(c, "ACTION=remove"))
+			{
+				added = 1;
+			}
+		}
+		changed |= power;
+		bat->rescan |= power && added;
+	}
+	return changed;
+}
@@ -0,0 +1,157 @@
+#include <stdlib.h>    // NULL, size_t, malloc(), free()
+#include <string.h>    // strchr()
+#include <stdint.h>    // int64_t
+#include <time.h>      // strftime(), localtime_r(), mktime(), tzset()
+#include <locale.h>    // setlocale()
+#include "succade.h"   // thing_s, builtin_s
+
+/*
+ * Built-in clock: renders the current date and/or time according to the
+ * block's strftime() format. Instead of updating every second, the block
+ * only wakes up when the formatted text can change next: on the next second,
+ * minute or hour, or at midnight, depending on the conversions in the format.
+ */
+
+enum clock_unit
+{
+	CLOCK_UNIT_SECOND,
+	CLOCK_UNIT_MINUTE,
+	CLOCK_UNIT_HOUR,
+	CLOCK_UNIT_DAY
+};
+
+struct clock_data
+{
+	const char     *format;  // strftime() format, owned by the block's config
+	enum clock_unit unit;    // smallest unit of time the format shows
+};
+
+/*
+ * Returns the smallest unit of time shown by the given strftime() format.
+ * Conversions that we don't know about are assumed to change every second.
+ */
+static enum clock_unit clock_unit(const char *format)
+{
+	enum clock_unit unit = CLOCK_UNIT_DAY;
+	for (const char *c = strchr(format, '%'); c && c[1]; c = strchr(c + 1, '%'))
+	{
+		++c;
+
+		// skip the modifiers (%Ey, %OH) and glibc's flags and widths (%-d, %_5H)
+		while (*c && strchr("EO_-0^#123456789", *c))
+		{
+			++c;
+		}
+
+		enum clock_unit u = CLOCK_UNIT_SECOND;
+		if (*c == '\0')
+		{
+			break;
+		}
+		if (strchr("%nt", *c))
+		{
+			continue;
+		}
+		if (strchr("aAbBCdDeFgGhjmuUVwWxyY", *c))
+		{
+			u = CLOCK_UNIT_DAY;
+		}
+		else if (strchr("HIklpPzZ", *c))
+		{
+			u = CLOCK_UNIT_HOUR;  // the time zone changes on the hour (DST)
+		}
+		else if (strchr("MR", *c))
+		{
+			u = CLOCK_UNIT_MINUTE;
+		}
+		if (u < unit)
+		{
+			unit = u;
+		}
+	}
+	return unit;
+}
+
+int clock_open(state_s *state, thing_s *block)
+{
+	// time zone and locale are looked up once, localtime_r() won't do it again
+	static int initialized = 0;
+	if (!initialized)
+	{
+		tzset();
+		setlocale(LC_TIME, "");
+		initialized = 1;
+	}
+
+	struct clock_data *clock = malloc(sizeof(struct clock_data));
+	if (clock == NULL)
+	{
+		return -1;
+	}
+
+	clock->format = cfg_get_str(&block->cfg, BLOCK_OPT_FORMAT);
+	if (empty(clock->format))
+	{
+		clock->format = DEFAULT_CLOCK_FORMAT;
+	}
+	clock->unit = clock_unit(clock->format);
+
+	block->data = clock;
+	return 0;
+}
+
+int64_t clock_update(state_s *state, thing_s *block, int64_t now, char *buf, size_t len)
+{
+	struct clock_data *clock = block->data;
+
+	// the monotonic reading is taken right after the wall clock's, so adding
+	// the wait to it never wakes us before the boundary, at worst just after
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	int64_t mono = get_time();
+
+	struct tm tm;
+	localtime_r(&ts.tv_sec, &tm);
+	if (strftime(buf, len, clock->format, &tm) == 0)
+	{
+		buf[0] = '\0';
+	}
+
+	// find the start of the next second, minute, hour or day; mktime() takes
+	// care of overflowing fields, as well as changes to or from DST
+	time_t next = ts.tv_sec + 1;
+	if (clock->unit > CLOCK_UNIT_SECOND)
+	{
+		tm.tm_sec = 0;
+		switch (clock->unit)
+		{
+			case CLOCK_UNIT_MINUTE:
+				tm.tm_min += 1;
+				break;
+			case CLOCK_UNIT_HOUR:
+				tm.tm_min   = 0;
+				tm.tm_hour += 1;
+				break;
+			default:
+				tm.tm_min   = 0;
+				tm.tm_hour  = 0;
+				tm.tm_mday += 1;
+				break;
+		}
+		tm.tm_isdst = -1;
+		next = mktime(&tm);
+		if (next <= ts.tv_sec)
+		{
+			next = ts.tv_sec + 1;
+		}
+	}
+
+	int64_t wait = (int64_t) (next - ts.tv_sec) * NANOSEC_PER_SEC - ts.tv_nsec;
+	return mono + wait;
+}
+
+void clock_close(thing_s *block)
+{
+	free(block->data);
+	block->data = NULL;
+}
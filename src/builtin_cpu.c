@@ -0,0 +1,222 @@
+#include <stdlib.h>    // NULL, size_t, malloc(), calloc(), free()
+#include <stdio.h>     // snprintf()
+#include <string.h>    // strncmp()
+#include <stdint.h>    // int64_t, uint64_t
+#include <fcntl.h>     // open(), O_RDONLY, O_CLOEXEC
+#include <unistd.h>    // close(), sysconf()
+#include "succade.h"   // thing_s, builtin_s
+
+/*
+ * Built-in CPU usage: keeps /proc/stat open and reads it again on every
+ * update, into a buffer that is allocated once, big enough for the cpu lines
+ * of all configured cores, then works out how busy the CPU (as a whole and
+ * every core by itself) has been since the last update. Cores are kept by
+ * their id, which doesn't have to be contiguous, as offline cores are left
+ * out of /proc/stat. The format can use the placeholders {usage} for the
+ * total usage in percent, {cpuN} for the usage of core N, and {cores} for
+ * that of all cores that are online.
+ */
+
+struct cpu_time
+{
+	uint64_t busy;           // time spent on anything but idling
+	uint64_t total;          // time spent, in total
+};
+
+struct cpu_core
+{
+	struct cpu_time last;    // times as of the last update
+	int             usage;   // usage in percent
+	int             online;  // was in /proc/stat on the last update?
+};
+
+struct cpu_data
+{
+	int              fd;     // /proc/stat
+	const char      *format; // format, owned by the block's config
+	size_t           num;    // number of cores, or rather, highest core id + 1
+	struct cpu_core *cores;  // total first, then per core, by id + 1
+	char            *buf;    // buffer for the cpu lines of /proc/stat
+	size_t           len;    // size of the buffer
+};
+
+/*
+ * Reads /proc/stat and calls `line` for every cpu line in it, with the index
+ * (0 for the total, core id + 1 for the cores) and the times. Returns the
+ * highest index found, or -1 on error.
+ */
+static int cpu_read(struct cpu_data *cpu, void (*line)(struct cpu_data*, size_t, struct cpu_time*))
+{
+	if (read_fd(cpu->fd, cpu->buf, cpu->len) <= 0)
+	{
+		return -1;
+	}
+
+	// the cpu lines come first, we're done with the first line that isn't one
+	int max = 0;
+	for (const char *c = cpu->buf; strncmp(c, "cpu", 3) == 0; )
+	{
+		c += 3;
+		size_t idx = (*c == ' ') ? 0 : read_number(&c) + 1;
+
+		// user nice system idle iowait irq softirq steal (guest is in user)
+		uint64_t t[8] = { 0 };
+		for (int i = 0; i < 8; ++i)
+		{
+			t[i] = read_number(&c);
+		}
+		struct cpu_time time = { .busy = t[0] + t[1] + t[2] + t[5] + t[6] + t[7] };
+		time.total = time.busy + t[3] + t[4];
+
+		if (line)
+		{
+			line(cpu, idx, &time);
+		}
+		if ((int) idx > max)
+		{
+			max = idx;
+		}
+
+		c = strchr(c, '\n');
+		if (c == NULL)
+		{
+			break;
+		}
+		++c;
+	}
+	return max;
+}
+
+/*
+ * Works out the usage for the given cpu line since the last update.
+ */
+static void cpu_line(struct cpu_data *cpu, size_t idx, struct cpu_time *time)
+{
+	if (idx > cpu->num)
+	{
+		return; // core that wasn't even configured when we started
+	}
+
+	struct cpu_core *core = &cpu->cores[idx];
+	uint64_t busy  = time->busy  - core->last.busy;
+	uint64_t total = time->total - core->last.total;
+	if (time->total > core->last.total)
+	{
+		core->usage = (int) ((busy * 100 + total / 2) / total);
+	}
+	core->last   = *time;
+	core->online = 1;
+}
+
+static int cpu_lookup(const char *name, size_t name_len, char *val, size_t val_len, void *data)
+{
+	struct cpu_data *cpu = data;
+
+	if (name_len == 5 && strncmp(name, "usage", 5) == 0)
+	{
+		snprintf(val, val_len, "%d", cpu->cores[0].usage);
+		return 0;
+	}
+	if (name_len == 5 && strncmp(name, "cores", 5) == 0)
+	{
+		size_t pos = 0;
+		val[0] = '\0';
+		for (size_t i = 1; i <= cpu->num && pos < val_len; ++i)
+		{
+			if (cpu->cores[i].online)
+			{
+				pos += snprintf(val + pos, val_len - pos, pos ? " %d" : "%d", cpu->cores[i].usage);
+			}
+		}
+		return 0;
+	}
+	if (name_len > 3 && strncmp(name, "cpu", 3) == 0)
+	{
+		const char *c = name + 3;
+		size_t idx = read_number(&c) + 1;
+		if (c == name + name_len && idx <= cpu->num)
+		{
+			snprintf(val, val_len, "%d", cpu->cores[idx].usage);
+			return 0;
+		}
+	}
+	return -1;
+}
+
+void cpu_close(thing_s *block)
+{
+	struct cpu_data *cpu = block->data;
+	if (cpu == NULL)
+	{
+		return;
+	}
+
+	if (cpu->fd != -1)
+	{
+		close(cpu->fd);
+	}
+	free(cpu->cores);
+	free(cpu->buf);
+	free(cpu);
+	block->data = NULL;
+}
+
+int cpu_open(state_s *state, thing_s *block)
+{
+	struct cpu_data *cpu = malloc(sizeof(struct cpu_data));
+	if (cpu == NULL)
+	{
+		return -1;
+	}
+
+	*cpu = (struct cpu_data) { .fd = -1 };
+	block->data = cpu;
+
+	// one line for the total, one for every core that might be online
+	long conf = sysconf(_SC_NPROCESSORS_CONF);
+	if (conf < 1)
+	{
+		conf = 1;
+	}
+	cpu->len = (conf + 1) * BUFFER_PROC_STAT_LINE;
+	cpu->buf = malloc(cpu->len);
+	cpu->fd  = open("/proc/stat", O_RDONLY | O_CLOEXEC);
+
+	int max = (cpu->buf == NULL || cpu->fd == -1) ? -1 : cpu_read(cpu, NULL);
+	if (max < 0)
+	{
+		cpu_close(block);
+		return -1;
+	}
+
+	cpu->num   = max > conf ? max : conf;
+	cpu->cores = calloc(cpu->num + 1, sizeof(struct cpu_core));
+	if (cpu->cores == NULL)
+	{
+		cpu_close(block);
+		return -1;
+	}
+
+	cpu->format = cfg_get_str(&block->cfg, BLOCK_OPT_FORMAT);
+	if (empty(cpu->format))
+	{
+		cpu->format = DEFAULT_CPU_FORMAT;
+	}
+
+	// without a first reading, the first update shows the average since boot
+	return 0;
+}
+
+int64_t cpu_update(state_s *state, thing_s *block, int64_t now, char *buf, size_t len)
+{
+	struct cpu_data *cpu = block->data;
+
+	// cores that went offline won't be in there
+	for (size_t i = 0; i <= cpu->num; ++i)
+	{
+		cpu->cores[i].online = 0;
+	}
+	cpu_read(cpu, cpu_line);
+	fill_template(buf, len, cpu->format, cpu_lookup, cpu);
+	return 0;
+}
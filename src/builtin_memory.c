@@ -0,0 +1,311 @@
+#include <stdlib.h>    // NULL, size_t, malloc(), free()
+#include <stdio.h>     // snprintf()
+#include <string.h>    // strncmp(), strchr(), memchr(), memcpy()
+#include <stdint.h>    // int64_t, uint64_t
+#include <fcntl.h>     // open(), O_RDONLY, O_CLOEXEC
+#include <unistd.h>    // close()
+#include "succade.h"   // thing_s, builtin_s
+
+/*
+ * Built-in memory and swap usage: keeps /proc/meminfo open and reads it
+ * again on every update, only looking for the keys the format needs. The
+ * format can use any key of /proc/meminfo as placeholder, like {MemFree}, as
+ * well as {total}, {free} (available, really), {used}, {swap_total},
+ * {swap_free} and {swap_used}. A unit can be appended: {used:M} for MiB,
+ * {used:G} for GiB, {used:k} for KiB or {used:%} for percent of the total;
+ * without one, the most fitting of k, M and G will be used, with the unit.
+ */
+
+struct memory_key
+{
+	char     name[32];       // key in /proc/meminfo
+	uint64_t kb;             // value, in KiB
+};
+
+struct memory_data
+{
+	int               fd;    // /proc/meminfo
+	const char       *format;// format, owned by the block's config
+	size_t            num;   // number of keys we're looking for
+	struct memory_key keys[MEMORY_KEYS_MAX];
+	char              buf[BUFFER_PROC_MEMINFO];
+};
+
+/*
+ * Placeholders that aren't keys of /proc/meminfo: their value is `key`,
+ * minus `minus`, if given; the total they are a part of is `total`.
+ */
+static const struct
+{
+	const char *name;
+	const char *key;
+	const char *minus;
+	const char *total;
+}
+memory_derived[] =
+{
+	{ "total",      "MemTotal",     NULL,           "MemTotal"  },
+	{ "free",       "MemAvailable", NULL,           "MemTotal"  },
+	{ "used",       "MemTotal",     "MemAvailable", "MemTotal"  },
+	{ "swap_total", "SwapTotal",    NULL,           "SwapTotal" },
+	{ "swap_free",  "SwapFree",     NULL,           "SwapTotal" },
+	{ "swap_used",  "SwapTotal",    "SwapFree",     "SwapTotal" },
+};
+
+#define MEMORY_NUM_DERIVED (sizeof(memory_derived) / sizeof(memory_derived[0]))
+
+/*
+ * Returns the index of the key with the given name, -1 if we don't have it.
+ */
+static int memory_find(struct memory_data *mem, const char *name, size_t len)
+{
+	if (len >= sizeof(mem->keys[0].name))
+	{
+		return -1;
+	}
+	for (size_t i = 0; i < mem->num; ++i)
+	{
+		if (strncmp(mem->keys[i].name, name, len) == 0 && mem->keys[i].name[len] == '\0')
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+/*
+ * Adds the key with the given name to the keys we're looking for, unless we
+ * are looking for it already.
+ */
+static void memory_want(struct memory_data *mem, const char *name, size_t len)
+{
+	if (memory_find(mem, name, len) != -1)
+	{
+		return;
+	}
+	// no key of /proc/meminfo is that long, and it wouldn't fit anyway
+	if (mem->num == MEMORY_KEYS_MAX || len >= sizeof(mem->keys[0].name))
+	{
+		return;
+	}
+	memcpy(mem->keys[mem->num].name, name, len);
+	mem->keys[mem->num].name[len] = '\0';
+	mem->keys[mem->num].kb = 0;
+	++mem->num;
+}
+
+/*
+ * Returns the derived placeholder with the given name, or -1 if there is none.
+ */
+static int memory_derived_idx(const char *name, size_t len)
+{
+	for (size_t i = 0; i < MEMORY_NUM_DERIVED; ++i)
+	{
+		if (strncmp(memory_derived[i].name, name, len) == 0 && memory_derived[i].name[len] == '\0')
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+/*
+ * Returns the value of the key with the given name, in KiB, 0 if not found.
+ */
+static uint64_t memory_kb(struct memory_data *mem, const char *name)
+{
+	int i = memory_find(mem, name, strlen(name));
+	return i == -1 ? 0 : mem->keys[i].kb;
+}
+
+/*
+ * Reads /proc/meminfo in one pass, picking out the keys we're looking for,
+ * and stops as soon as we've got all of them. Returns 0 on success, -1 on
+ * error.
+ */
+static int memory_read(struct memory_data *mem)
+{
+	if (read_fd(mem->fd, mem->buf, sizeof(mem->buf)) <= 0)
+	{
+		return -1;
+	}
+
+	size_t left = mem->num;
+	for (const char *c = mem->buf; *c && left; )
+	{
+		const char *colon = strchr(c, ':');
+		if (colon == NULL)
+		{
+			break;
+		}
+
+		int i = memory_find(mem, c, colon - c);
+		if (i != -1)
+		{
+			c = colon + 1;
+			mem->keys[i].kb = read_number(&c);
+			--left;
+		}
+
+		c = strchr(c, '\n');
+		if (c == NULL)
+		{
+			break;
+		}
+		++c;
+	}
+	return 0;
+}
+
+/*
+ * Formats `kb` with the given unit: 'k', 'M', 'G' or 0 for the most fitting
+ * of those, in which case the unit will be part of the output.
+ */
+static void memory_format(char *val, size_t len, uint64_t kb, char unit)
+{
+	switch (unit)
+	{
+		case 'k':
+			snprintf(val, len, "%llu", (unsigned long long) kb);
+			break;
+		case 'M':
+			snprintf(val, len, "%llu", (unsigned long long) (kb / 1024));
+			break;
+		case 'G':
+			snprintf(val, len, "%.1f", kb / (1024.0 * 1024.0));
+			break;
+		default:
+			if (kb >= 1024 * 1024)
+			{
+				snprintf(val, len, "%.1fG", kb / (1024.0 * 1024.0));
+			}
+			else if (kb >= 1024)
+			{
+				snprintf(val, len, "%lluM", (unsigned long long) (kb / 1024));
+			}
+			else
+			{
+				snprintf(val, len, "%lluk", (unsigned long long) kb);
+			}
+			break;
+	}
+}
+
+static int memory_lookup(const char *name, size_t name_len, char *val, size_t val_len, void *data)
+{
+	struct memory_data *mem = data;
+
+	// split off the unit, if any
+	char unit = 0;
+	if (name_len > 2 && name[name_len - 2] == ':')
+	{
+		unit = name[name_len - 1];
+		name_len -= 2;
+	}
+
+	uint64_t kb    = 0;
+	uint64_t total = 0;
+	int d = memory_derived_idx(name, name_len);
+	if (d != -1)
+	{
+		kb = memory_kb(mem, memory_derived[d].key);
+		if (memory_derived[d].minus)
+		{
+			uint64_t minus = memory_kb(mem, memory_derived[d].minus);
+			kb = kb > minus ? kb - minus : 0;
+		}
+		total = memory_kb(mem, memory_derived[d].total);
+	}
+	else
+	{
+		int i = memory_find(mem, name, name_len);
+		if (i == -1)
+		{
+			return -1;
+		}
+		kb    = mem->keys[i].kb;
+		total = memory_kb(mem, "MemTotal");
+	}
+
+	if (unit == '%')
+	{
+		snprintf(val, val_len, "%d", total ? (int) ((kb * 100 + total / 2) / total) : 0);
+		return 0;
+	}
+	memory_format(val, val_len, kb, unit);
+	return 0;
+}
+
+int memory_open(state_s *state, thing_s *block)
+{
+	struct memory_data *mem = malloc(sizeof(struct memory_data));
+	if (mem == NULL)
+	{
+		return -1;
+	}
+
+	mem->fd = open("/proc/meminfo", O_RDONLY | O_CLOEXEC);
+	if (mem->fd == -1)
+	{
+		free(mem);
+		return -1;
+	}
+
+	mem->format = cfg_get_str(&block->cfg, BLOCK_OPT_FORMAT);
+	if (empty(mem->format))
+	{
+		mem->format = DEFAULT_MEMORY_FORMAT;
+	}
+
+	// find out which keys we need, so we don't have to look for the others
+	mem->num = 0;
+	memory_want(mem, "MemTotal", strlen("MemTotal")); // for percentages
+	for (const char *c = strchr(mem->format, '{'); c; c = strchr(c + 1, '{'))
+	{
+		const char *end = strchr(c, '}');
+		if (end == NULL)
+		{
+			break;
+		}
+		const char *colon = memchr(c, ':', end - c);
+		size_t len = (colon ? colon : end) - c - 1;
+
+		int d = memory_derived_idx(c + 1, len);
+		if (d == -1)
+		{
+			memory_want(mem, c + 1, len);
+			continue;
+		}
+		memory_want(mem, memory_derived[d].key, strlen(memory_derived[d].key));
+		memory_want(mem, memory_derived[d].total, strlen(memory_derived[d].total));
+		if (memory_derived[d].minus)
+		{
+			memory_want(mem, memory_derived[d].minus, strlen(memory_derived[d].minus));
+		}
+	}
+
+	block->data = mem;
+	return 0;
+}
+
+int64_t memory_update(state_s *state, thing_s *block, int64_t now, char *buf, size_t len)
+{
+	struct memory_data *mem = block->data;
+
+	memory_read(mem);
+	fill_template(buf, len, mem->format, memory_lookup, mem);
+	return 0;
+}
+
+void memory_close(thing_s *block)
+{
+	struct memory_data *mem = block->data;
+	if (mem == NULL)
+	{
+		return;
+	}
+
+	close(mem->fd);
+	free(mem);
+	block->data = NULL;
+}
@@ -0,0 +1,380 @@
+#include <stdlib.h>    // NULL, size_t, malloc(), free()
+#include <stdio.h>     // snprintf()
+#include <string.h>    // strncmp(), strlen(), strchr(), strstr(), memcpy()
+#include <errno.h>     // errno, ENOBUFS
+#include <stdint.h>    // int64_t, uint64_t
+#include <fcntl.h>     // open(), O_RDONLY, O_CLOEXEC
+#include <unistd.h>    // close()
+#include <ifaddrs.h>   // getifaddrs(), freeifaddrs()
+#include <net/if.h>    // IFF_UP, IFF_RUNNING, IFF_LOOPBACK, IF_NAMESIZE
+#include <arpa/inet.h> // inet_ntop()
+#include <sys/socket.h>        // socket(), bind(), recv()
+#include <linux/netlink.h>     // sockaddr_nl, nlmsghdr, NLMSG_OK(), ...
+#include <linux/rtnetlink.h>   // RTMGRP_LINK, ifinfomsg, ifaddrmsg, ...
+#include "succade.h"   // thing_s, builtin_s
+
+/*
+ * Built-in network status: subscribes to the kernel's routing netlink for
+ * changes of links and addresses, and only looks at the interface again
+ * when one of those comes in, so the block shows an interface going up or
+ * down, or getting a new address, right away. The format can use {name} for
+ * the interface's name, {state} ('up' or 'down'), {ipv4} and {ipv6} for its
+ * first IPv4 and (not link-local) IPv6 address, as well as {rx} and {tx} for
+ * the bytes received and sent per second. Only if the format asks for those,
+ * /proc/net/dev will be read every `interval` seconds (1 by default). The
+ * interface can be given with `interface`, otherwise the first one that is
+ * up and isn't the loopback interface will be used.
+ */
+
+struct network_data
+{
+	int           sock;      // rtnetlink socket, -1 if we poll
+	int           dev;       // /proc/net/dev, -1 if the format has no rates
+	const char   *iface;     // interface to show, NULL to pick one
+	unsigned      index;     // index of the interface shown, 0 if none
+	const char   *format;    // format, owned by the block's config
+	kita_state_s *kita;      // kita state the socket is watched by
+
+	char          name[IF_NAMESIZE];
+	int           up;        // interface is up and running?
+	char          ipv4[INET_ADDRSTRLEN];
+	char          ipv6[INET6_ADDRSTRLEN];
+
+	uint64_t      rx_bytes;  // bytes received, as of the last update
+	uint64_t      tx_bytes;  // bytes sent, as of the last update
+	int64_t       last;      // time of the last update, 0 if none yet
+	uint64_t      rx_rate;   // bytes per second received
+	uint64_t      tx_rate;   // bytes per second sent
+
+	char          buf[BUFFER_NETWORK];
+};
+
+/*
+ * Opens a netlink socket that gets notified of changes of links and IPv4 and
+ * IPv6 addresses. Returns the socket, -1 on error.
+ */
+static int network_rtnetlink()
+{
+	int sock = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+	if (sock == -1)
+	{
+		return -1;
+	}
+
+	struct sockaddr_nl addr = { .nl_family = AF_NETLINK,
+		.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR };
+	if (bind(sock, (struct sockaddr*) &addr, sizeof(addr)) == -1)
+	{
+		close(sock);
+		return -1;
+	}
+	return sock;
+}
+
+/*
+ * Looks up the state and addresses of the interface to show, picking one
+ * if none was given.
+ */
+static void network_scan(struct network_data *net)
+{
+	// rates don't carry over from one interface to another
+	char last[IF_NAMESIZE];
+	memcpy(last, net->name, sizeof(last));
+
+	// an interface that was asked for keeps its name, even while it's gone
+	snprintf(net->name, sizeof(net->name), "%s", net->iface ? net->iface : "");
+	net->ipv4[0] = net->ipv6[0] = '\0';
+	net->up = 0;
+	net->index = 0;
+
+	struct ifaddrs *ifas;
+	if (getifaddrs(&ifas) == -1)
+	{
+		return;
+	}
+
+	// pick the first interface that is up, or failing that, any at all
+	const char *name = net->iface;
+	for (int pass = 0; name == NULL && pass < 2; ++pass)
+	{
+		for (struct ifaddrs *ifa = ifas; ifa; ifa = ifa->ifa_next)
+		{
+			int up = (ifa->ifa_flags & (IFF_UP | IFF_RUNNING)) == (IFF_UP | IFF_RUNNING);
+			if (!(ifa->ifa_flags & IFF_LOOPBACK) && (up || pass == 1))
+			{
+				name = ifa->ifa_name;
+				break;
+			}
+		}
+	}
+
+	for (struct ifaddrs *ifa = ifas; name && ifa; ifa = ifa->ifa_next)
+	{
+		if (!equals(ifa->ifa_name, name))
+		{
+			continue;
+		}
+		if (net->index == 0)
+		{
+			snprintf(net->name, sizeof(net->name), "%s", name);
+			net->index = if_nametoindex(name);
+			net->up = (ifa->ifa_flags & (IFF_UP | IFF_RUNNING)) == (IFF_UP | IFF_RUNNING);
+		}
+		if (ifa->ifa_addr == NULL)
+		{
+			continue;
+		}
+		if (ifa->ifa_addr->sa_family == AF_INET && net->ipv4[0] == '\0')
+		{
+			struct sockaddr_in *sin = (struct sockaddr_in*) ifa->ifa_addr;
+			inet_ntop(AF_INET, &sin->sin_addr, net->ipv4, sizeof(net->ipv4));
+		}
+		if (ifa->ifa_addr->sa_family == AF_INET6 && net->ipv6[0] == '\0')
+		{
+			struct sockaddr_in6 *sin6 = (struct sockaddr_in6*) ifa->ifa_addr;
+			if (!IN6_IS_ADDR_LINKLOCAL(&sin6->sin6_addr))
+			{
+				inet_ntop(AF_INET6, &sin6->sin6_addr, net->ipv6, sizeof(net->ipv6));
+			}
+		}
+	}
+	freeifaddrs(ifas);
+
+	if (!equals(last, net->name))
+	{
+		net->last = 0;
+		net->rx_rate = net->tx_rate = 0;
+	}
+}
+
+/*
+ * Reads the interface's byte counters from /proc/net/dev and works out the
+ * rates since the last update.
+ */
+static void network_rates(struct network_data *net, int64_t now)
+{
+	if (net->dev == -1 || read_fd(net->dev, net->buf, sizeof(net->buf)) <= 0)
+	{
+		return;
+	}
+
+	// lines look like '  eth0: <8 receive counters> <8 transmit counters>'
+	size_t len = strlen(net->name);
+	for (const char *c = strchr(net->buf, '\n'); len && c; c = strchr(c, '\n'))
+	{
+		++c;
+		while (*c == ' ')
+		{
+			++c;
+		}
+		if (strncmp(c, net->name, len) != 0 || c[len] != ':')
+		{
+			continue;
+		}
+
+		c += len + 1;
+		uint64_t rx = read_number(&c);
+		for (int i = 0; i < 7; ++i)
+		{
+			read_number(&c);
+		}
+		uint64_t tx = read_number(&c);
+
+		// updates for link or address changes may come just after another
+		// one; rates over such short spans are mostly noise, so skip them
+		int64_t elapsed = now - net->last;
+		if (net->last && elapsed < NETWORK_MIN_SAMPLE * NANOSEC_PER_MILLISEC)
+		{
+			return;
+		}
+
+		// counters go back to 0 if the interface is created anew
+		if (net->last && rx >= net->rx_bytes && tx >= net->tx_bytes)
+		{
+			net->rx_rate = (rx - net->rx_bytes) * NANOSEC_PER_SEC / elapsed;
+			net->tx_rate = (tx - net->tx_bytes) * NANOSEC_PER_SEC / elapsed;
+		}
+		net->rx_bytes = rx;
+		net->tx_bytes = tx;
+		net->last     = now;
+		return;
+	}
+
+	// interface is gone (or there is none)
+	net->rx_rate = net->tx_rate = 0;
+	net->last = 0;
+}
+
+/*
+ * Formats a rate in bytes per second, in the most fitting unit.
+ */
+static void network_format_rate(char *val, size_t len, uint64_t rate)
+{
+	if (rate >= 1024 * 1024 * 1024)
+	{
+		snprintf(val, len, "%.1fG", rate / (1024.0 * 1024.0 * 1024.0));
+	}
+	else if (rate >= 1024 * 1024)
+	{
+		snprintf(val, len, "%.1fM", rate / (1024.0 * 1024.0));
+	}
+	else if (rate >= 1024)
+	{
+		snprintf(val, len, "%lluK", (unsigned long long) (rate / 1024));
+	}
+	else
+	{
+		snprintf(val, len, "%lluB", (unsigned long long) rate);
+	}
+}
+
+static int network_lookup(const char *name, size_t name_len, char *val, size_t val_len, void *data)
+{
+	struct network_data *net = data;
+
+	if (name_len == 4 && strncmp(name, "name", 4) == 0)
+	{
+		snprintf(val, val_len, "%s", net->name);
+		return 0;
+	}
+	if (name_len == 5 && strncmp(name, "state", 5) == 0)
+	{
+		snprintf(val, val_len, "%s", net->up ? "up" : "down");
+		return 0;
+	}
+	if (name_len == 4 && strncmp(name, "ipv4", 4) == 0)
+	{
+		snprintf(val, val_len, "%s", net->ipv4);
+		return 0;
+	}
+	if (name_len == 4 && strncmp(name, "ipv6", 4) == 0)
+	{
+		snprintf(val, val_len, "%s", net->ipv6);
+		return 0;
+	}
+	if (name_len == 2 && strncmp(name, "rx", 2) == 0)
+	{
+		network_format_rate(val, val_len, net->rx_rate);
+		return 0;
+	}
+	if (name_len == 2 && strncmp(name, "tx", 2) == 0)
+	{
+		network_format_rate(val, val_len, net->tx_rate);
+		return 0;
+	}
+	return -1;
+}
+
+void network_close(thing_s *block)
+{
+	struct network_data *net = block->data;
+	if (net == NULL)
+	{
+		return;
+	}
+
+	if (net->sock != -1)
+	{
+		kita_unwatch_fd(net->kita, net->sock);
+		close(net->sock);
+	}
+	if (net->dev != -1)
+	{
+		close(net->dev);
+	}
+	free(net);
+	block->data = NULL;
+}
+
+int network_open(state_s *state, thing_s *block)
+{
+	struct network_data *net = malloc(sizeof(struct network_data));
+	if (net == NULL)
+	{
+		return -1;
+	}
+
+	*net = (struct network_data) { .sock = -1, .dev = -1 };
+	net->kita  = state->kita;
+	net->iface = cfg_get_str(&block->cfg, BLOCK_OPT_INTERFACE);
+	if (empty(net->iface))
+	{
+		net->iface = NULL;
+	}
+	net->format = cfg_get_str(&block->cfg, BLOCK_OPT_FORMAT);
+	if (empty(net->format))
+	{
+		net->format = DEFAULT_NETWORK_FORMAT;
+	}
+
+	// only read the counters if we have to show rates
+	if (strstr(net->format, "{rx}") || strstr(net->format, "{tx}"))
+	{
+		net->dev = open("/proc/net/dev", O_RDONLY | O_CLOEXEC);
+	}
+
+	// without rtnetlink, we'll have to poll, like a script would
+	net->sock = network_rtnetlink();
+	if (net->sock != -1 && kita_watch_fd(state->kita, net->sock, block) == -1)
+	{
+		close(net->sock);
+		net->sock = -1;
+	}
+
+	block->data = net;
+	return 0;
+}
+
+int64_t network_update(state_s *state, thing_s *block, int64_t now, char *buf, size_t len)
+{
+	struct network_data *net = block->data;
+
+	network_scan(net);
+	network_rates(net, now);
+	fill_template(buf, len, net->format, network_lookup, net);
+
+	// with rtnetlink, there's only something to wait for if we show rates
+	return (net->sock == -1 || net->dev != -1) ? 0 : -1;
+}
+
+/*
+ * Reads all messages that came in on the rtnetlink socket, returns 1 if any
+ * of them was about the interface shown (or might make us show another one),
+ * otherwise 0.
+ */
+int network_event(state_s *state, thing_s *block, int fd)
+{
+	struct network_data *net = block->data;
+	int changed = 0;
+
+	ssize_t n;
+	while ((n = recv(fd, net->buf, sizeof(net->buf), 0)) > 0)
+	{
+		for (struct nlmsghdr *nh = (struct nlmsghdr*) net->buf; NLMSG_OK(nh, n);
+				nh = NLMSG_NEXT(nh, n))
+		{
+			switch (nh->nlmsg_type)
+			{
+				case RTM_NEWLINK:
+				case RTM_DELLINK:
+					// the interface might have been created anew, or the
+					// one we picked might not be the one to pick anymore
+					changed = 1;
+					break;
+				case RTM_NEWADDR:
+				case RTM_DELADDR:
+				{
+					struct ifaddrmsg *ifa = NLMSG_DATA(nh);
+					changed |= ifa->ifa_index == net->index;
+					break;
+				}
+			}
+		}
+	}
+	// if the socket's buffer ran over, we missed something, whatever it was
+	if (n == -1 && errno == ENOBUFS)
+	{
+		changed = 1;
+	}
+	return changed;
+}
@@ -0,0 +1,143 @@
+#include <stdlib.h>    // NULL, size_t, calloc(), free()
+#include <string.h>    // strdup(), strcmp()
+#include <stdint.h>    // int64_t
+#include "succade.h"   // cache_s, cache_entry_s
+
+/*
+ * Result cache for sparked blocks that consume their spark's output: maps the
+ * consumed input to the output the block gave for it, so that the block does
+ * not have to be run again for input it has seen recently. Entries expire
+ * after `ttl`; once all `cap` entries are in use, the one that has been used
+ * least recently makes room for the new one. Sparks usually cycle through a
+ * handful of values, so a plain array with linear search is all we need.
+ */
+
+/*
+ * Sets up the cache with room for `cap` entries that expire after `ttl`
+ * nanoseconds. The entries will only be allocated once something is stored.
+ * A `cap` or `ttl` of 0 disables the cache.
+ */
+void cache_init(cache_s *cache, size_t cap, int64_t ttl)
+{
+	*cache = (cache_s) { 0 };
+	cache->cap = ttl > 0 ? cap : 0;
+	cache->ttl = ttl > 0 ? ttl : 0;
+}
+
+/*
+ * Returns 1 if the cache is enabled, otherwise 0.
+ */
+int cache_enabled(const cache_s *cache)
+{
+	return cache->cap > 0;
+}
+
+/*
+ * Returns the entry for the given key, or NULL if there is none.
+ */
+static cache_entry_s *cache_find(cache_s *cache, const char *key)
+{
+	for (size_t i = 0; i < cache->num; ++i)
+	{
+		if (strcmp(cache->entries[i].key, key) == 0)
+		{
+			return &cache->entries[i];
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Returns the value stored for the given key, or NULL if there is none or if
+ * it has expired. The returned string is owned by the cache and stays valid
+ * until the next call to cache_put() or cache_free().
+ */
+const char *cache_get(cache_s *cache, const char *key, int64_t now)
+{
+	cache_entry_s *entry = cache_find(cache, key);
+	if (entry == NULL || now - entry->stored > cache->ttl)
+	{
+		return NULL;
+	}
+
+	entry->used = now;
+	return entry->value;
+}
+
+/*
+ * Stores a copy of `value` for the given key, replacing the previous value
+ * for the key, if any. If the cache is full, the least recently used entry
+ * will be replaced. Returns 0 on success, -1 on error.
+ */
+int cache_put(cache_s *cache, const char *key, const char *value, int64_t now)
+{
+	if (!cache_enabled(cache))
+	{
+		return -1;
+	}
+	if (cache->entries == NULL)
+	{
+		cache->entries = calloc(cache->cap, sizeof(cache_entry_s));
+		if (cache->entries == NULL)
+		{
+			return -1;
+		}
+	}
+
+	char *copy = strdup(value);
+	if (copy == NULL)
+	{
+		return -1;
+	}
+
+	cache_entry_s *entry = cache_find(cache, key);
+	if (entry == NULL)
+	{
+		char *key_copy = strdup(key);
+		if (key_copy == NULL)
+		{
+			free(copy);
+			return -1;
+		}
+
+		if (cache->num < cache->cap)
+		{
+			entry = &cache->entries[cache->num++];
+		}
+		else
+		{
+			// evict the least recently used entry
+			entry = &cache->entries[0];
+			for (size_t i = 1; i < cache->num; ++i)
+			{
+				if (cache->entries[i].used < entry->used)
+				{
+					entry = &cache->entries[i];
+				}
+			}
+			free(entry->key);
+		}
+		entry->key = key_copy;
+	}
+
+	free(entry->value);
+	entry->value  = copy;
+	entry->stored = now;
+	entry->used   = now;
+	return 0;
+}
+
+/*
+ * Frees all entries of the cache.
+ */
+void cache_free(cache_s *cache)
+{
+	for (size_t i = 0; i < cache->num; ++i)
+	{
+		free(cache->entries[i].key);
+		free(cache->entries[i].value);
+	}
+	free(cache->entries);
+	cache->entries = NULL;
+	cache->num = 0;
+}
@@ -1,7 +1,10 @@
 #include <stdio.h>  // snprintf()
 #include <stdlib.h> // malloc(), free(), getenv()
+#include <stdint.h> // int64_t, uint64_t
 #include <string.h> // strlen(), strcmp()
 #include <time.h>   // clock_gettime(), clockid_t, struct timespec
+#include <errno.h>  // errno, EINTR
+#include <unistd.h> // pread()
 
 /*
  * Returns 1 if both input strings are equal, otherwise 0.
@@ -229,10 +232,58 @@ char *config_path(const char *filename, const char *dirname)
 }
 
 /*
- * Returns the seconds that have passed since an unspecified starting point,
- * (see CLOCK_MONOTONIC), in seconds, as a floating point number.
+ * Parses a list of CPUs, like "0-3,6", and returns it as a bit mask with one
+ * bit per CPU. Only the first 64 CPUs are supported. Returns 0 if the list is
+ * empty or invalid.
  */
-double get_time()
+uint64_t cpu_list(const char *list)
+{
+	uint64_t mask = 0;
+	const char *str = list;
+	while (*str)
+	{
+		char *end = NULL;
+		long from = strtol(str, &end, 10);
+		long to   = from;
+		if (end == str)
+		{
+			return 0;
+		}
+		if (*end == '-')
+		{
+			str = end + 1;
+			to = strtol(str, &end, 10);
+			if (end == str)
+			{
+				return 0;
+			}
+		}
+		if (from < 0 || to > 63 || from > to)
+		{
+			return 0;
+		}
+		for (long cpu = from; cpu <= to; ++cpu)
+		{
+			mask |= 1ULL << cpu;
+		}
+		if (*end == ',')
+		{
+			++end;
+		}
+		else if (*end != '\0')
+		{
+			return 0;
+		}
+		str = end;
+	}
+	return mask;
+}
+
+/*
+ * Returns the time that has passed since an unspecified starting point,
+ * (see CLOCK_MONOTONIC), in nanoseconds.
+ */
+int64_t get_time()
 {
 	clockid_t cid = CLOCK_MONOTONIC;
 	// TODO the next line is cool, as CLOCK_MONOTONIC is not
@@ -242,7 +293,86 @@ double get_time()
 	//clockid_t cid = (sysconf(_SC_MONOTONIC_CLOCK) > 0) ? CLOCK_MONOTONIC : CLOCK_REALTIME;
 	struct timespec ts;
 	clock_gettime(cid, &ts);
-	return (double) ts.tv_sec + ts.tv_nsec / 1000000000.0;
+	return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+ * Like get_time(), but returns the wall clock time (CLOCK_REALTIME), which 
+ * is subject to adjustments, so it should only be used for alignment.
+ */
+int64_t get_time_real()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (int64_t) ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+ * Reads the file behind `fd` from the start (via pread(), so the file can be
+ * kept open and read again and again, like files in /proc and /sys) into 
+ * `buf`, up to `len - 1` bytes, and null-terminates it. Returns the number 
+ * of bytes read or -1 on error.
+ */
+ssize_t read_fd(int fd, char *buf, size_t len)
+{
+	ssize_t n;
+	while ((n = pread(fd, buf, len - 1, 0)) == -1 && errno == EINTR)
+	{
+		// retry
+	}
+	buf[n > 0 ? n : 0] = '\0';
+	return n;
+}
+
+/*
+ * Parses the unsigned number at the start of `str`, skipping leading spaces,
+ * then advances `str` to just after it. Unlike strtoull(), this doesn't care
+ * about the locale, which makes it a lot faster for the files in /proc.
+ * Returns the number, or 0 if there was none.
+ */
+uint64_t read_number(const char **str)
+{
+	const char *c = *str;
+	uint64_t num = 0;
+	while (*c == ' ')
+	{
+		++c;
+	}
+	while (*c >= '0' && *c <= '9')
+	{
+		num = num * 10 + (*c++ - '0');
+	}
+	*str = c;
+	return num;
+}
+
+/*
+ * Copies the template `tpl` to `buf`, replacing all placeholders, which are
+ * names in curly braces, like `{name}`, with what the `lookup` function writes
+ * to `val` for the name; `lookup` returns 0 if it knows the name, otherwise 
+ * -1, in which case the placeholder will be copied as-is. The result will be
+ * truncated to fit `buf`. Returns the length of the result.
+ */
+size_t fill_template(char *buf, size_t len, const char *tpl, 
+		int (*lookup)(const char *name, size_t name_len, char *val, size_t val_len, void *data),
+		void *data)
+{
+	char   val[256];
+	size_t pos = 0;
+	while (*tpl && pos + 1 < len)
+	{
+		const char *end = (*tpl == '{') ? strchr(tpl, '}') : NULL;
+		if (end && lookup(tpl + 1, end - tpl - 1, val, sizeof(val), data) == 0)
+		{
+			pos += snprintf(buf + pos, len - pos, "%s", val);
+			pos  = pos < len ? pos : len - 1;
+			tpl  = end + 1;
+			continue;
+		}
+		buf[pos++] = *tpl++;
+	}
+	buf[pos] = '\0';
+	return pos;
 }
 
 /*
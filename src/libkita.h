@@ -3,6 +3,9 @@
 
 #include <stdio.h>  // _IONBF, _IOLBF, _IOFBF
 #include <unistd.h> // STDOUT_FILENO, STDIN_FILENO, STDERR_FILENO
+#include <signal.h> // sigset_t
+#include <stdint.h> // uint64_t
+#include <time.h>   // struct timespec
 
 ////////////////////////////////////////////////////////////////////////////////
 //                                                                            //
@@ -20,6 +23,14 @@
 // Buffers etc
 #define KITA_BUFFER_SIZE 2048
 #define KITA_MS_PER_S    1000
+#define KITA_MAX_EVENTS    32 // default size of the epoll event array
+#define KITA_SLAB_SIZE     32 // initial number of child slots in the registry
+#define KITA_FDS_SIZE      64 // initial size of the fd lookup table
+#define KITA_PIDS_SIZE     64 // initial size of the pid hash table (power of 2)
+#define KITA_SPAWN_STACK  65536 // stack size for children spawned via clone()
+#define KITA_ZYGOTE_BUF   16384 // max size of a spawn request sent to the zygote
+#define KITA_ZYGOTE_FDS    1024 // file descriptors to close when starting the zygote
+#define KITA_SHELL    "/bin/sh" // runs scripts that lack a shebang line
 
 // Errors
 #define KITA_ERR_NONE              0
@@ -61,27 +72,54 @@ enum kita_evt_type {
 	KITA_EVT_CHILD_OPENED,   // child was opened TODO not sure we need this
 	KITA_EVT_CHILD_CLOSED,   // child was closed 
 	KITA_EVT_CHILD_REAPED,   // child was reaped
-	KITA_EVT_CHILD_HANGUP,   // child has hung up TODO this and 'EXITED' are kinda same?
-	KITA_EVT_CHILD_EXITED,   // child has exited  TODO this and 'HANGUP' are kinda same?
+	KITA_EVT_CHILD_HANGUP,   // child has hung up (one of its streams was closed)
+	KITA_EVT_CHILD_EXITED,   // child has exited (and is about to be reaped)
 	KITA_EVT_CHILD_FEEDOK,   // child is ready to be fed data
 	KITA_EVT_CHILD_READOK,   // child has data available to read
 	KITA_EVT_CHILD_REMOVE,   // child is about to be removed from state
 	KITA_EVT_CHILD_ERROR,    // an error occurred
+	KITA_EVT_TIMER,          // the state's timer has expired (no child)
+	KITA_EVT_FD_READOK,      // a watched file descriptor is readable (no child)
 	KITA_EVT_COUNT
 };
 
 enum kita_opt_type {
 	KITA_OPT_AUTOCLEAN,      // automatically remove reaped children?
 	KITA_OPT_AUTOTERM,       // automatically terminate fully closed children?
-	KITA_OPT_LAST_LINE,      // only read last line, if multiple lines available
+	KITA_OPT_LAST_LINE,      // no effect, reading lines always gets the last one
 	KITA_OPT_NO_NEWLINE,     // remove '\n' from the end of data, if reading lines
 	KITA_OPT_COUNT
 };
 
+enum kita_spawn_type {
+	KITA_SPAWN_FORK,         // fork(), then exec
+	KITA_SPAWN_VFORK,        // vfork(), then exec
+	KITA_SPAWN_CLONE,        // clone() with CLONE_VM | CLONE_VFORK, then exec
+	KITA_SPAWN_POSIX,        // posix_spawnp()
+	KITA_SPAWN_ZYGOTE,       // have a helper process fork(), then exec
+	KITA_SPAWN_COUNT
+};
+
+enum kita_io_class {
+	KITA_IO_NONE,            // no class, I/O priority follows the nice value
+	KITA_IO_RT,              // real-time, always served first (root only)
+	KITA_IO_BE,              // best-effort, the default class
+	KITA_IO_IDLE             // idle, only served when no one else needs the disk
+};
+
+enum kita_prio_opt {
+	KITA_PRIO_NICE  = 1,     // `nice` is set
+	KITA_PRIO_SCHED = 2,     // `sched` is set
+	KITA_PRIO_IO    = 4,     // `io_class` and `io_level` are set
+	KITA_PRIO_CPUS  = 8      // `cpus` is set
+};
+
 typedef enum kita_ios_type kita_ios_type_e;
 typedef enum kita_buf_type kita_buf_type_e;
 typedef enum kita_evt_type kita_evt_type_e;
 typedef enum kita_opt_type kita_opt_type_e;
+typedef enum kita_spawn_type kita_spawn_type_e;
+typedef enum kita_io_class kita_io_class_e;
 
 //
 // STRUCTS 
@@ -92,23 +130,49 @@ struct kita_child;
 struct kita_event;
 struct kita_calls;
 struct kita_stream;
+struct kita_stats;
+struct kita_prio;
+struct kita_watch;
 
 typedef struct kita_state kita_state_s;
 typedef struct kita_child kita_child_s;
 typedef struct kita_event kita_event_s;
 typedef struct kita_calls kita_calls_s;
 typedef struct kita_stream kita_stream_s;
+typedef struct kita_stats kita_stats_s;
+typedef struct kita_prio kita_prio_s;
+typedef struct kita_watch kita_watch_s;
 
 typedef void (*kita_call_c)(kita_state_s* s, kita_event_s* e);
 
 struct kita_stream
 {
-	FILE* fp;
-	int   fd;
+	int   fd;                // file descriptor, -1 if closed
 
 	kita_ios_type_e ios_type;
 	kita_buf_type_e buf_type;
 	unsigned registered : 1;  // child registered with epoll? TODO do we need this?
+	unsigned skip : 1;        // discarding the rest of an overlong line?
+	uint32_t tag;            // tag of the fd's epoll registration, see libkita_tag()
+
+	char*  buf;              // read buffer, allocated once, on first read
+	size_t len;              // number of bytes in the read buffer
+	size_t hold;             // bytes at the front holding the last line returned
+
+	char*  out;              // input that is partially written (stdin only)
+	size_t out_len;          // length of the partially written input
+	size_t out_off;          // number of bytes of it written so far
+	char*  next;             // newest input, waiting for `out` (stdin only)
+};
+
+struct kita_prio
+{
+	int      set;            // which of the following are set, see kita_prio_opt
+	int      nice;           // nice value, -20 (highest priority) to 19 (lowest)
+	int      sched;          // scheduling policy: SCHED_OTHER, SCHED_BATCH, SCHED_IDLE
+	int      io_class;       // I/O scheduling class, see kita_io_class
+	int      io_level;       // I/O priority within the class, 0 (highest) to 7
+	uint64_t cpus;           // CPUs to run on, one bit per CPU (first 64 only)
 };
 
 struct kita_child
@@ -117,10 +181,23 @@ struct kita_child
 	char* arg;               // additional argument string (optional)
 	pid_t pid;               // process ID
 
+	char** argv;             // `cmd`, expanded via wordexp(), plus two spare slots
+	size_t argc;             // number of arguments in `argv`
+	char*  exe;              // absolute path of the executable, resolved via PATH
+	char*  exe_env;          // value of PATH that `exe` was resolved with
+
 	kita_stream_s* io[3];    // stream objects for stdin, stdout, stderr
+	int group;               // run in a process group of its own?
+	int pipe_size;           // size of the stdout pipe in bytes, 0 for default
+	kita_prio_s prio;        // priority and CPUs to run with, if any
 	int status;              // status returned by waitpid(), if any
+	int pidfd;               // pidfd for exit notification, if any
+	int spawning;            // waiting for the zygote to create the process?
+	uint32_t pidfd_tag;      // tag of the pidfd's epoll registration
+	struct timespec exited;  // time of exit (CLOCK_MONOTONIC), if reaped
 
 	kita_state_s* state;     // tracking state, if any
+	size_t slot;             // slot in the state's registry, if tracked
 
 	void* ctx;               // user data
 };
@@ -131,17 +208,62 @@ struct kita_event
 	kita_evt_type_e type;    // event type
 	kita_ios_type_e ios;     // stdin, stdout, stderr?
 	int fd;                  // file descriptor for the relevant child's stream
-	int size;                // number of bytes available for reading
+	int size;                // number of bytes available for reading, -1 if unknown
+	void* ctx;               // user data of the watched fd, see kita_watch_fd()
+};
+
+struct kita_watch
+{
+	int   fd;                // file descriptor, owned by the user
+	void* ctx;               // user data, handed out with its events
+	uint32_t tag;            // tag of the fd's epoll registration
+};
+
+struct kita_stats
+{
+	unsigned long ticks;     // number of calls to kita_tick()
+	unsigned long events;    // number of epoll events handled in total
+	unsigned long timers;    // number of times the timer has expired
+	unsigned long feeds;     // number of inputs fed to children
+	unsigned long superseded;// inputs replaced by newer ones before written
+	unsigned long dropped;   // inputs discarded due to write errors or close
+	int last_batch;          // number of events handled in the last tick
+	int max_batch;           // highest number of events handled in one tick
 };
 
 struct kita_state
 {
-	kita_child_s** children; // child processes
+	kita_child_s** children; // child slots (slab), NULL for free slots
 	size_t num_children;     // num of child processes
+	size_t cap_children;     // num of slots in the slab
+	size_t* free_slots;      // stack of free slot indices
+	size_t num_free;         // num of free slot indices on the stack
+
+	kita_child_s** fds;      // lookup table, indexed by file descriptor
+	size_t num_fds;          // size of the fd lookup table
+
+	kita_child_s** pids;     // hash table (open addressing), keyed by PID
+	size_t cap_pids;         // size of the pid hash table (power of 2)
+	size_t num_pids;         // num of entries in the pid hash table
 
 	kita_call_c cbs[KITA_EVT_COUNT]; // event callbacks
 
 	int epfd;                // epoll file descriptor
+	int sigfd;               // signalfd for SIGCHLD, if pidfds unavailable
+	int tfd;                 // timerfd, see kita_set_timer()
+	kita_watch_s* watches;   // file descriptors watched for the user
+	uint32_t tags;           // last tag handed out, see libkita_tag()
+	size_t num_watches;      // num of watched file descriptors
+	size_t num_unwatched;    // num of running children without a pidfd
+	struct epoll_event* events; // event array for epoll_pwait()
+	int max_events;          // size of the event array
+	kita_spawn_type_e spawn; // how to create child processes
+	int zygote;              // socket to the zygote, if any, see kita_set_spawn()
+	pid_t zygote_pid;        // PID of the zygote, if any
+	kita_child_s** spawning; // children waiting for the zygote, in request order
+	size_t num_spawning;     // num of children waiting for the zygote
+	size_t cap_spawning;     // size of the queue of children waiting
+	kita_stats_s stats;      // event counters, for diagnostics
 	sigset_t sigset;         // signals to be ignored by epoll_wait
 	int error;               // last error that occured
 	unsigned char options[KITA_OPT_COUNT]; // boolean options
@@ -160,6 +282,12 @@ int kita_set_callback(kita_state_s* s, kita_evt_type_e type, kita_call_c cb);
 // Main flow control
 int kita_loop(kita_state_s* s);
 int kita_tick(kita_state_s* s, int timeout);
+int kita_set_max_events(kita_state_s* s, int max);
+int kita_set_spawn(kita_state_s* s, kita_spawn_type_e type);
+int kita_set_timer(kita_state_s* s, const struct timespec* ts);
+int kita_watch_fd(kita_state_s* s, int fd, void *ctx);
+int kita_unwatch_fd(kita_state_s* s, int fd);
+const kita_stats_s* kita_get_stats(kita_state_s* s);
 
 // Children: creating, deleting, registering
 kita_child_s* kita_child_new(const char* cmd, int in, int out, int err);
@@ -174,11 +302,14 @@ void          kita_child_set_context(kita_child_s* c, void *ctx);
 void*         kita_child_get_context(kita_child_s* c);
 void          kita_child_set_arg(kita_child_s* c, char* arg);
 char*         kita_child_get_arg(kita_child_s* c);
+void          kita_child_set_group(kita_child_s* c, int group);
+void          kita_child_set_prio(kita_child_s* c, const kita_prio_s* prio);
+void          kita_child_set_pipe_size(kita_child_s* c, int size);
 kita_state_s* kita_child_get_state(kita_child_s* c);
 
 // Children: opening, reading, writing, killing
 int   kita_child_feed(kita_child_s* c, const char* str);
-char* kita_child_read(kita_child_s* c, kita_ios_type_e n);
+const char* kita_child_read(kita_child_s* c, kita_ios_type_e n);
 int   kita_child_open(kita_child_s* c);
 int   kita_child_close(kita_child_s* c); 
 int   kita_child_reap(kita_child_s* c);
@@ -189,6 +320,9 @@ int   kita_child_term(kita_child_s* c);
 int kita_child_is_open(kita_child_s* c);
 int kita_child_is_alive(kita_child_s* c);
 
+// Priority of the calling process
+int kita_apply_prio(const kita_prio_s* prio);
+
 // Clean-up and shut-down
 void kita_kill(kita_state_s* s);
 void kita_free(kita_state_s** s);
@@ -212,18 +346,38 @@ void* kita_get_context(kita_state_s* s);
 #ifdef KITA_IMPLEMENTATION
 
 #include <stdlib.h>    // NULL, size_t, EXIT_SUCCESS, EXIT_FAILURE, ...
+#include <stdint.h>    // uint64_t
 #include <unistd.h>    // pipe(), fork(), dup(), close(), _exit(), ...
-#include <string.h>    // strlen()
+#include <string.h>    // strlen(), memrchr() (_GNU_SOURCE)
 #include <errno.h>     // errno
 #include <fcntl.h>     // fcntl(), F_GETFL, F_SETFL, O_NONBLOCK
-#include <spawn.h>     // posix_spawnp()
+#include <spawn.h>     // posix_spawnp(), posix_spawn_file_actions_*()
+#include <sched.h>     // clone(), CLONE_VM, CLONE_VFORK (_GNU_SOURCE)
 #include <wordexp.h>   // wordexp(), wordfree(), ...
 #include <sys/epoll.h> // epoll_create, epoll_wait(), ... 
 #include <sys/types.h> // pid_t
+#include <sys/stat.h>  // stat(), S_ISREG()
+#include <sys/socket.h> // socketpair(), sendmsg(), recvmsg(), SCM_RIGHTS
+#include <sys/prctl.h> // prctl(), PR_SET_PDEATHSIG, PR_SET_NAME
+#include <sys/resource.h> // setpriority(), PRIO_PROCESS
 #include <sys/wait.h>  // waitpid()
 #include <sys/ioctl.h> // ioctl(), FIONREAD
+#include <sys/signalfd.h> // signalfd()
+#include <sys/timerfd.h>  // timerfd_create(), timerfd_settime()
+#include <sys/syscall.h>  // syscall(), SYS_pidfd_open, SYS_close_range
 #include "libkita.h"
 
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open 434   // same number on all architectures
+#endif
+
+#ifndef SYS_close_range
+#define SYS_close_range 436  // same number on all architectures
+#endif
+
+#define KITA_IOPRIO_WHO_PROCESS 1  // from linux/ioprio.h, which isn't always there
+#define KITA_IOPRIO_CLASS_SHIFT 13
+
 static volatile int running;   // Main loop control 
 extern char **environ;         // Required to pass the environment to children
 
@@ -240,405 +394,1365 @@ libkita_empty(const char *str)
 }
 
 /*
- * Opens the process `cmd` similar to popen() but does not invoke a shell.
- * Instead, wordexp() is used to expand the given command, if necessary.
- * If successful, the process id of the new process is being returned and the 
- * given FILE pointers are set to streams that correspond to pipes for reading 
- * and writing to the child process, accordingly. Hand in NULL for pipes that
- * should not be used. On error, -1 is returned. Note that the child process 
- * might have failed to execute the given `cmd` (and therefore ended exection); 
- * the return value of this function only indicates whether the child process 
- * was successfully forked or not.
+ * Everything the child side of libkita_popen() needs, prepared by the parent,
+ * so that the child doesn't have to allocate memory or touch any shared state
+ * before exec'ing; this is required for the vfork() and clone() backends,
+ * where the child runs in the parent's memory until it calls exec.
  */
-static pid_t
-libkita_popen(const char *cmd, FILE **in, FILE **out, FILE **err)
-{
-	if (!cmd || !strlen(cmd))
-	{
-		return -1;
-	}
+struct libkita_spawn
+{
+	const char *exe;         // path of the executable
+	char **argv;             // arguments, including the command itself
+	int fds[3][2];           // pipes for stdin, stdout, stderr, -1 if unused
+	sigset_t mask;           // signal mask to exec the command with
+	int pgroup;              // put the child in a process group of its own?
+	kita_prio_s prio;        // priority and CPUs to run the child with
+};
 
-	// 0 = read end of pipes, 1 = write end of pipes
-	int pipe_stdin[2];
-	int pipe_stdout[2];
-	int pipe_stderr[2];
+/*
+ * Applies the given priority settings to the calling process. Only calls 
+ * functions that are async-signal-safe, so it can be used in the child after
+ * vfork() or clone(). Settings that can't be applied (for example, a lower 
+ * nice value without the required privileges) are skipped, the others still
+ * apply. Returns 0 if all settings have been applied, -1 otherwise.
+ */
+static int
+libkita_apply_prio(const kita_prio_s *prio)
+{
+	int res = 0;
 
-	if (in && (pipe(pipe_stdin) < 0))
-	{
-		return -1;
-	}
-	if (out && (pipe(pipe_stdout) < 0))
+	if (prio->set & KITA_PRIO_NICE)
 	{
-		return -1;
+		res |= setpriority(PRIO_PROCESS, 0, prio->nice);
 	}
-	if (err && (pipe(pipe_stderr) < 0))
+	if (prio->set & KITA_PRIO_SCHED)
 	{
-		return -1;
+		struct sched_param param = { .sched_priority = 0 };
+		res |= sched_setscheduler(0, prio->sched, &param);
 	}
-
-	pid_t pid = fork();
-	if (pid == -1)
+	if (prio->set & KITA_PRIO_IO)
 	{
-		return -1;
+		int ioprio = prio->io_class << KITA_IOPRIO_CLASS_SHIFT | prio->io_level;
+		res |= syscall(SYS_ioprio_set, KITA_IOPRIO_WHO_PROCESS, 0, ioprio);
 	}
-	else if (pid == 0) // child
+#ifdef CPU_SET
+	if (prio->set & KITA_PRIO_CPUS)
 	{
-		// redirect stdin to the read end of this pipe
-		if (in)
-		{
-			if (dup2(pipe_stdin[0], STDIN_FILENO) == -1)
-			{
-				_exit(-1);
-			}
-			close(pipe_stdin[1]); // child doesn't need write end
-		}
-		// redirect stdout to the write end of this pipe
-		if (out)
-		{
-			if (dup2(pipe_stdout[1], STDOUT_FILENO) == -1)
-			{
-				_exit(-1);
-			}
-			close(pipe_stdout[0]); // child doesn't need read end
-		}
-		// redirect stderr to the write end of this pipe
-		if (err)
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		for (int cpu = 0; cpu < 64; ++cpu)
 		{
-			if (dup2(pipe_stderr[1], STDERR_FILENO) == -1)
+			if (prio->cpus & (1ULL << cpu))
 			{
-				_exit(-1);
+				CPU_SET(cpu, &cpus);
 			}
-			close(pipe_stderr[0]); // child doesn't need read end
-		}
-
-		wordexp_t p;
-		if (wordexp(cmd, &p, 0) != 0)
-		{
-			_exit(-1);
-		}
-	
-		// Child process could not be run (errno has more info)	
-		if (execvp(p.we_wordv[0], p.we_wordv) == -1)
-		{
-			_exit(-1);
-		}
-		_exit(1);
-	}
-	else // parent
-	{
-		if (in)
-		{
-			close(pipe_stdin[0]);  // parent doesn't need read end
-			*in = fdopen(pipe_stdin[1], "w");
-		}
-		if (out)
-		{
-			close(pipe_stdout[1]); // parent doesn't need write end
-			*out = fdopen(pipe_stdout[0], "r");
-		}
-		if (err)
-		{
-			close(pipe_stderr[1]); // parent doesn't need write end
-			*err = fdopen(pipe_stderr[0], "r");
 		}
-		return pid;
+		res |= sched_setaffinity(0, sizeof(cpus), &cpus);
 	}
+#endif
+	return res ? -1 : 0;
 }
 
 /*
- * Examines the given file descriptor for the number of bytes available for 
- * reading and returns that number. On error, -1 will be returned.
+ * Fills `sh_argv`, which needs room for two more entries than `argv` has
+ * (including its terminating NULL), with the arguments to run the script 
+ * `exe`, which lacks a shebang line, with the shell: "sh <exe> <args...>". 
+ * This is what execvp() does when exec fails with ENOEXEC. Only touches the
+ * given arrays, so it is async-signal-safe.
  */
-static int
-libkita_fd_data_avail(int fd)
+static void
+libkita_sh_argv(const char *exe, char **argv, char **sh_argv)
 {
-	int bytes = 0;
-	return ioctl(fd, FIONREAD, &bytes) == -1 ? -1 : bytes;
+	sh_argv[0] = "sh";
+	sh_argv[1] = (char *) exe;
+	size_t i = 1;
+	do
+	{
+		sh_argv[i + 1] = argv[i];
+	}
+	while (argv[i++]);
 }
 
-static int
-libkita_child_has_fd(kita_child_s *child, int fd)
+/*
+ * Returns the number of arguments in `argv`, not counting the NULL at the end.
+ */
+static size_t
+libkita_argc(char **argv)
 {
-	for (int i = 0; i < 3; ++i)
+	size_t argc = 0;
+	while (argv[argc])
 	{
-		if (child->io[i] && child->io[i]->fd == fd)
-		{
-			return 1;
-		}
+		++argc;
 	}
-	return 0;
+	return argc;
 }
 
 /*
- * Finds and returns the child with the given `pid` or NULL.
+ * Child side of libkita_popen(): resets signal handlers, redirects the std
+ * streams to the pipes and exec's the command. Only calls functions that are
+ * async-signal-safe and never returns. Suitable for fork(), vfork(), clone().
  */
-static kita_child_s*
-libkita_child_get_by_pid(kita_state_s *state, pid_t pid)
+static int
+libkita_spawn_child(void *arg)
 {
-	for (size_t i = 0; i < state->num_children; ++i)
-	{	
-		if (state->children[i]->pid == pid)
+	struct libkita_spawn *sp = arg;
+
+	// don't let the parent's signal handlers run in here, we might be
+	// sharing the parent's memory; exec would reset them anyway
+	struct sigaction sa_dfl = { .sa_handler = SIG_DFL };
+	for (int sig = 1; sig < NSIG; ++sig)
+	{
+		struct sigaction sa;
+		if (sigaction(sig, NULL, &sa) == 0 && sa.sa_handler != SIG_DFL && sa.sa_handler != SIG_IGN)
 		{
-			return state->children[i];
+			sigaction(sig, &sa_dfl, NULL);
 		}
 	}
-	return NULL;
-}
 
-static kita_child_s*
-libkita_child_get_by_fd(kita_state_s *state, int fd)
-{
-	for (size_t i = 0; i < state->num_children; ++i)
+	// SIGCHLD might be blocked (signalfd), don't pass that on
+	sigprocmask(SIG_SETMASK, &sp->mask, NULL);
+
+	// become the leader of a new process group, along with our children
+	if (sp->pgroup)
+	{
+		setpgid(0, 0);
+	}
+
+	// nice value, scheduling policy etc. are inherited across exec
+	libkita_apply_prio(&sp->prio);
+
+	// redirect stdin to the read end, stdout and stderr to the write ends
+	for (int i = 0; i < 3; ++i)
 	{
-		if (libkita_child_has_fd(state->children[i], fd))
+		if (sp->fds[i][0] == -1)
+		{
+			continue;
+		}
+		int use = (i == STDIN_FILENO) ? 0 : 1;
+		if (sp->fds[i][use] == i)
+		{
+			// already in place, but dup2() would keep FD_CLOEXEC
+			fcntl(i, F_SETFD, 0);
+		}
+		else if (dup2(sp->fds[i][use], i) == -1)
 		{
-			return state->children[i];
+			_exit(127);
 		}
+	}
+
+	// all pipes are close-on-exec, but other file descriptors we might have
+	// inherited ourselves may not be; the child shouldn't get any of them
+	syscall(SYS_close_range, STDERR_FILENO + 1, ~0U, 0);
 
+	execve(sp->exe, sp->argv, environ);
+
+	// not an executable format the kernel knows, so a script without a 
+	// shebang line: have the shell run it, like execvp() would; the new
+	// argv goes on the stack, we mustn't allocate memory in here
+	if (errno == ENOEXEC)
+	{
+		char *sh_argv[libkita_argc(sp->argv) + 2];
+		libkita_sh_argv(sp->exe, sp->argv, sh_argv);
+		execve(KITA_SHELL, sh_argv, environ);
 	}
-	return NULL;
+
+	// Child process could not be run (errno has more info)
+	_exit(127);
 }
 
 /*
- * Find the index (array position) of the given child.
- * Returns the index position or -1 if no such child found.
+ * Spawns the child via posix_spawn(), with file actions for the redirection
+ * of the std streams. Returns the child's PID or -1 on error, with errno set.
  */
-static int
-libkita_child_get_idx(kita_state_s *state, kita_child_s *child)
+static pid_t
+libkita_spawn_posix(struct libkita_spawn *sp)
 {
-	for (size_t i = 0; i < state->num_children; ++i)
+	posix_spawn_file_actions_t fa;
+	posix_spawnattr_t attr;
+	pid_t pid = -1;
+
+	if (posix_spawn_file_actions_init(&fa) != 0)
 	{
-		if (state->children[i] == child)
-		{
-			return i;
-		}
+		return -1;
+	}
+	if (posix_spawnattr_init(&attr) != 0)
+	{
+		posix_spawn_file_actions_destroy(&fa);
+		return -1;
 	}
-	return -1;
-}
 
-static kita_ios_type_e
-libkita_child_fd_get_type(kita_child_s *child, int fd)
-{
 	for (int i = 0; i < 3; ++i)
 	{
-		if (child->io[i] && child->io[i]->fd == fd)
+		if (sp->fds[i][0] == -1)
 		{
-			return (kita_ios_type_e) i;
+			continue;
 		}
+		int use = (i == STDIN_FILENO) ? 0 : 1;
+		posix_spawn_file_actions_adddup2(&fa, sp->fds[i][use], i);
 	}
-	return -1;
-}
 
-static int
-libkita_stream_set_buf_type(kita_stream_s *stream, kita_buf_type_e buf)
-{
-	// From the setbuf manpage:
-	// > The setvbuf() function may be used only after opening a stream
-	// > and before any other operations have been performed on it.
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 34))
+	// see libkita_spawn_child(), the pipes themselves are close-on-exec
+	posix_spawn_file_actions_addclosefrom_np(&fa, STDERR_FILENO + 1);
+#endif
+
+	// reset all handled signals, use the given signal mask
+	sigset_t all;
+	sigfillset(&all);
+	posix_spawnattr_setsigdefault(&attr, &all);
+	posix_spawnattr_setsigmask(&attr, &sp->mask);
+	posix_spawnattr_setpgroup(&attr, 0);
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK
+			| (sp->pgroup ? POSIX_SPAWN_SETPGROUP : 0));
 
-	if (stream->fp == NULL) // can't modify if not yet open
+	int err = posix_spawn(&pid, sp->exe, &fa, &attr, sp->argv, environ);
+
+	// a script without a shebang line, see libkita_spawn_child()
+	if (err == ENOEXEC)
 	{
-		return -1;
+		char **sh_argv = malloc((libkita_argc(sp->argv) + 2) * sizeof(char*));
+		if (sh_argv)
+		{
+			libkita_sh_argv(sp->exe, sp->argv, sh_argv);
+			err = posix_spawn(&pid, KITA_SHELL, &fa, &attr, sh_argv, environ);
+			free(sh_argv);
+		}
 	}
-	
-	if (setvbuf(stream->fp, NULL, buf, 0) != 0)
+
+	posix_spawnattr_destroy(&attr);
+	posix_spawn_file_actions_destroy(&fa);
+
+	if (err != 0)
 	{
+		errno = err;
 		return -1;
 	}
-
-	stream->buf_type = buf;
-	return 0;
+	return pid;
 }
 
 /*
- * Register the given stream's file descriptor with the state's epoll instance.
+ * Spawns the child via clone(), sharing the parent's memory until the child
+ * has called exec (CLONE_VM | CLONE_VFORK), on a stack of its own. If clone()
+ * is not available (_GNU_SOURCE not defined), vfork() will be used instead.
+ * Returns the child's PID or -1 on error, with errno set.
  */
-static int
-libkita_stream_reg_ev(kita_state_s *state, kita_stream_s *stream)
+static pid_t
+libkita_spawn_clone(struct libkita_spawn *sp)
 {
-	if (stream->fp == NULL) // we don't register a closed stream
+#if defined(CLONE_VM) && defined(CLONE_VFORK)
+	char *stack = malloc(KITA_SPAWN_STACK);
+	if (stack == NULL)
 	{
 		return -1;
 	}
 
-	int fd = fileno(stream->fp);
-	int ev = stream->ios_type == KITA_IOS_IN ? EPOLLOUT : EPOLLIN;
+	// the stack grows downwards on all architectures we care about
+	pid_t pid = clone(libkita_spawn_child, stack + KITA_SPAWN_STACK,
+			CLONE_VM | CLONE_VFORK | SIGCHLD, sp);
 
-	struct epoll_event epev = { .events = ev | EPOLLET, .data.fd = fd };
-	
-	if (epoll_ctl(state->epfd, EPOLL_CTL_ADD, fd, &epev) == 0)
+	// with CLONE_VFORK, the child has exec'd or exited by now
+	free(stack);
+	return pid;
+#else
+	pid_t pid = vfork();
+	if (pid == 0)
 	{
-		stream->registered = 1;
-		return 0;
+		libkita_spawn_child(sp);
 	}
-	return -1;
+	return pid;
+#endif
 }
 
 /*
- * Remove the given stream's file descriptor from the state's epoll instance.
+ * Spawns the child with the given method. Returns the child's PID or -1 on
+ * error, with errno set. Methods that share the parent's memory are run with
+ * all signals blocked, so no signal handler can run in the child by accident.
  */
-static int
-libkita_stream_rem_ev(kita_state_s *state, kita_stream_s *stream)
+static pid_t
+libkita_spawn(kita_spawn_type_e type, struct libkita_spawn *sp)
 {
-	if (epoll_ctl(state->epfd, EPOLL_CTL_DEL, stream->fd, NULL) == 0)
+	pid_t pid = -1;
+	sigset_t all, old;
+
+	switch (type)
 	{
-		stream->registered = 0;
-		return 0;
+		case KITA_SPAWN_POSIX:
+			return libkita_spawn_posix(sp);
+
+		case KITA_SPAWN_VFORK:
+			sigfillset(&all);
+			sigprocmask(SIG_SETMASK, &all, &old);
+			pid = vfork();
+			if (pid == 0)
+			{
+				libkita_spawn_child(sp);
+			}
+			sigprocmask(SIG_SETMASK, &old, NULL);
+			return pid;
+
+		case KITA_SPAWN_CLONE:
+			sigfillset(&all);
+			sigprocmask(SIG_SETMASK, &all, &old);
+			pid = libkita_spawn_clone(sp);
+			sigprocmask(SIG_SETMASK, &old, NULL);
+			return pid;
+
+		default:
+			pid = fork();
+			if (pid == 0)
+			{
+				libkita_spawn_child(sp);
+			}
+			return pid;
 	}
-	return -1;
 }
 
 /*
- * Register all events for the given child with the epoll file descriptor.
- * Returns the number of events registered.
+ * Closes all file descriptors of the given pipes that are open.
  */
-static int 
-libkita_child_reg_events(kita_state_s *state, kita_child_s *child)
+static void
+libkita_close_pipes(int fds[3][2])
 {
-	int reg = 0;
 	for (int i = 0; i < 3; ++i)
 	{
-		if (child->io[i])
+		for (int j = 0; j < 2; ++j)
 		{
-			reg += libkita_stream_reg_ev(state, child->io[i]) == 0;
+			if (fds[i][j] != -1)
+			{
+				close(fds[i][j]);
+			}
 		}
 	}
-	return reg;
 }
 
 /*
- * Removes all events for the given child from the epoll file descriptor.
- * Returns the number of events deleted.
+ * Runs the child's resolved executable with its arguments, similar to popen(),
+ * but without invoking a shell; the child's process group and priority 
+ * settings are applied. The child process will be created with the given 
+ * `spawn` method; if that method isn't supported by the system, fork() will 
+ * be used instead. If successful, the process id of the new process is being
+ * returned and the given file descriptors are set to pipes for reading and 
+ * writing to the child process, accordingly. Hand in NULL for pipes that 
+ * should not be used. On error, -1 is returned. Note that the child process
+ * might have failed to execute (and therefore ended exection); the return 
+ * value of this function only indicates whether the child process was 
+ * successfully created or not (with the exception of KITA_SPAWN_POSIX, which
+ * might report a failure to execute as an error as well).
  */
-static int
-libkita_child_rem_events(kita_state_s *state, kita_child_s *child)
+static pid_t
+libkita_popen(const kita_child_s *child, int *in, int *out, int *err, kita_spawn_type_e spawn)
 {
-	int rem = 0;
+	struct libkita_spawn sp = {
+		.exe = child->exe, .argv = child->argv,
+		.pgroup = child->group, .prio = child->prio
+	};
+
+	// posix_spawn() has no attributes for the priority settings
+	if (spawn == KITA_SPAWN_POSIX && sp.prio.set)
+	{
+		spawn = KITA_SPAWN_VFORK;
+	}
+
+	// 0 = read end of pipes, 1 = write end of pipes; close-on-exec, so that
+	// no child ever gets to see the pipes of another one
+	int *ends[3] = { in, out, err };
 	for (int i = 0; i < 3; ++i)
 	{
-		if (child->io[i])
+		sp.fds[i][0] = sp.fds[i][1] = -1;
+		if (ends[i] && pipe2(sp.fds[i], O_CLOEXEC) < 0)
 		{
-			rem += libkita_stream_rem_ev(state, child->io[i]) == 0;
+			libkita_close_pipes(sp.fds);
+			return -1;
 		}
 	}
-	return rem;
-}
 
-/*
- * Closes the given stream via fclose().
- * Returns 0 on success, -1 if the stream wasn't open in the first place.
- */
-static int
-libkita_stream_close(kita_stream_s *stream)
-{
-	if (stream->fp == NULL)
+	// the child gets our signal mask, minus SIGCHLD (see libkita_init_reaping)
+	sigprocmask(SIG_SETMASK, NULL, &sp.mask);
+	sigdelset(&sp.mask, SIGCHLD);
+
+	pid_t pid = libkita_spawn(spawn, &sp);
+	if (pid == -1 && errno == ENOSYS && spawn != KITA_SPAWN_FORK)
+	{
+		pid = libkita_spawn(KITA_SPAWN_FORK, &sp);
+	}
+
+	if (pid == -1)
 	{
-		stream->fd = -1;
+		libkita_close_pipes(sp.fds);
 		return -1;
 	}
 
-	fclose(stream->fp);
-	stream->fp = NULL;
-	stream->fd = -1;
-	return 0;
+	// parent doesn't need the child's ends of the pipes
+	for (int i = 0; i < 3; ++i)
+	{
+		if (ends[i] == NULL)
+		{
+			continue;
+		}
+		int keep = (i == STDIN_FILENO) ? 1 : 0;
+		close(sp.fds[i][!keep]);
+		*ends[i] = sp.fds[i][keep];
+	}
+	return pid;
 }
 
 /*
- * Create a kita_stream_s struct on the heap (malloc'd) and 
- * initialize it to the given stream type `ios` and buffer type `buf`. 
- * Returns the allocated structure or NULL if out of memory.
+ * Header of a spawn request sent to the zygote, see libkita_zygote_send().
+ * It is followed by the path of the executable and then all arguments, each
+ * of them null terminated, all in the same message.
  */
-static kita_stream_s*
-libkita_stream_new(kita_ios_type_e ios)
+struct libkita_zygote_req
 {
-	kita_stream_s *stream = malloc(sizeof(kita_stream_s));
-	if (stream == NULL)
-	{
-		return NULL;
-	}
-	*stream = (kita_stream_s) { 0 };
-
-	// file descriptor
-	stream->fd = -1;
-	
-	// set stream type and stream buffer type
-	stream->ios_type = ios;
-	stream->buf_type = (ios == KITA_IOS_ERR) ? KITA_BUF_NONE : KITA_BUF_LINE;
+	unsigned char ios[3];    // which of stdin, stdout, stderr to create pipes for
+	unsigned char pgroup;    // put the child in a process group of its own?
+	kita_prio_s prio;        // priority and CPUs to run the child with
+	sigset_t mask;           // signal mask to exec the command with
+	uint32_t argc;           // number of arguments following the executable
+};
 
-	return stream;
-}
+/*
+ * Reply of the zygote to a spawn request. The parent's ends of the requested
+ * pipes are attached as SCM_RIGHTS, in the order stdin, stdout, stderr.
+ */
+struct libkita_zygote_rep
+{
+	pid_t pid;               // PID of the new child or -1 on error
+	int   err;               // errno, if the child could not be created
+};
 
 /*
- * Set the blocking behavior of the given stream, where 0 means non-blocking 
- * and 1 means blocking. Returns 0 on success, -1 on error.
+ * Sends the reply to a spawn request, along with the given file descriptors.
+ * Returns 0 on success, -1 on error.
  */
-int
-libkita_stream_set_blocking(kita_stream_s *stream, int blocking)
+static int
+libkita_zygote_reply(int sock, struct libkita_zygote_rep *rep, int *fds, int num_fds)
 {
-	if (stream->fp == NULL) // can't modify if not yet open
-	{
-		return -1;
-	}
+	struct iovec iov = { .iov_base = rep, .iov_len = sizeof(*rep) };
+	union {
+		char buf[CMSG_SPACE(sizeof(int) * 3)];
+		struct cmsghdr align;
+	} ctrl;
 
-	if (stream->fd < 2) // can't modify without valid file descriptor
+	struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1 };
+	if (num_fds > 0)
 	{
-		return -1;
-	}
-
-	//int fd = fileno(stream->fp);
-	int flags = fcntl(stream->fd, F_GETFL, 0);
+		msg.msg_control    = ctrl.buf;
+		msg.msg_controllen = CMSG_SPACE(sizeof(int) * num_fds);
 
-	if (flags == -1)
-	{
-		return -1;
-	}
-	if (blocking) // make blocking
-	{
-	  	flags &= ~O_NONBLOCK;
-	}
-	else          // make non-blocking
-	{
-		flags |=  O_NONBLOCK;
-	}
-	if (fcntl(stream->fd, F_SETFL, flags) != 0)
-	{
-		return -1;
+		struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type  = SCM_RIGHTS;
+		cmsg->cmsg_len   = CMSG_LEN(sizeof(int) * num_fds);
+		memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * num_fds);
 	}
 
-	return 0;
+	return sendmsg(sock, &msg, MSG_NOSIGNAL) == -1 ? -1 : 0;
 }
 
-static int
-libkita_child_open(kita_child_s *child)
+/*
+ * Main loop of the zygote: receives spawn requests, creates the pipes and
+ * the child process, then sends the parent's ends of the pipes back. The
+ * children are created with CLONE_PARENT, so they will be children of the
+ * zygote's parent, who can therefore wait for them just like for any other
+ * child. Returns (and the zygote should exit) once the socket is closed.
+ */
+static void
+libkita_zygote_main(int sock)
+{
+	char buf[KITA_ZYGOTE_BUF];
+	for (;;)
+	{
+		ssize_t len = recv(sock, buf, sizeof(buf) - 1, 0);
+		if (len == -1 && errno == EINTR)
+		{
+			continue;
+		}
+		if (len < (ssize_t) sizeof(struct libkita_zygote_req))
+		{
+			return;
+		}
+		buf[len] = '\0';
+
+		struct libkita_zygote_req req;
+		memcpy(&req, buf, sizeof(req));
+
+		// unpack executable and arguments, which are null terminated
+		char  *str  = buf + sizeof(req);
+		char  *end  = buf + len;
+		char **argv = malloc(sizeof(char*) * (req.argc + 1));
+		if (argv == NULL)
+		{
+			return;
+		}
+		const char *exe = str;
+		str += strlen(str) + 1;
+		for (uint32_t i = 0; i < req.argc; ++i)
+		{
+			argv[i] = str < end ? str : "";
+			str += strlen(argv[i]) + 1;
+		}
+		argv[req.argc] = NULL;
+
+		struct libkita_zygote_rep rep = { .pid = -1 };
+		struct libkita_spawn sp = {
+			.exe = exe, .argv = argv, .mask = req.mask,
+			.pgroup = req.pgroup, .prio = req.prio
+		};
+		for (int i = 0; i < 3; ++i)
+		{
+			sp.fds[i][0] = sp.fds[i][1] = -1;
+			if (req.ios[i] && pipe2(sp.fds[i], O_CLOEXEC) == -1)
+			{
+				rep.err = errno;
+			}
+		}
+
+		if (rep.err == 0)
+		{
+			// like fork(), but the child will be our parent's child
+			rep.pid = syscall(SYS_clone, CLONE_PARENT | SIGCHLD, 0, 0, 0, 0);
+			if (rep.pid == 0)
+			{
+				// we ignore all signals, the command shouldn't
+				for (int sig = 1; sig < NSIG; ++sig)
+				{
+					signal(sig, SIG_DFL);
+				}
+				libkita_spawn_child(&sp);
+			}
+			rep.err = (rep.pid == -1) ? errno : 0;
+		}
+
+		// send back the parent's ends: write end of stdin, read ends else
+		int fds[3];
+		int num_fds = 0;
+		for (int i = 0; i < 3 && rep.pid != -1; ++i)
+		{
+			if (sp.fds[i][0] != -1)
+			{
+				fds[num_fds++] = sp.fds[i][i == STDIN_FILENO ? 1 : 0];
+			}
+		}
+		libkita_zygote_reply(sock, &rep, fds, num_fds);
+		libkita_close_pipes(sp.fds);
+		free(argv);
+	}
+}
+
+/*
+ * Starts the zygote: a small helper process that creates child processes on
+ * our behalf, so that the cost of doing so doesn't depend on our own memory
+ * footprint. It should therefore be started as early as possible.
+ * Returns 0 on success, -1 on error.
+ */
+static int
+libkita_zygote_start(kita_state_s *state)
+{
+	if (state->zygote != -1)
+	{
+		return 0;
+	}
+
+	int sv[2];
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) == -1)
+	{
+		return -1;
+	}
+
+	pid_t pid = fork();
+	if (pid == -1)
+	{
+		close(sv[0]);
+		close(sv[1]);
+		return -1;
+	}
+
+	if (pid == 0)
+	{
+		// only keep the std streams and our end of the socket
+		for (int fd = STDERR_FILENO + 1; fd < KITA_ZYGOTE_FDS; ++fd)
+		{
+			if (fd != sv[1])
+			{
+				close(fd);
+			}
+		}
+
+		// don't get in the way of our parent's signals, but die with it;
+		// our name makes sure we don't get mistaken for our parent
+		for (int sig = 1; sig < NSIG; ++sig)
+		{
+			signal(sig, sig == SIGCHLD ? SIG_DFL : SIG_IGN);
+		}
+		prctl(PR_SET_PDEATHSIG, SIGKILL);
+		prctl(PR_SET_NAME, "kita-zygote");
+
+		libkita_zygote_main(sv[1]);
+		_exit(EXIT_SUCCESS);
+	}
+
+	close(sv[1]);
+	state->zygote     = sv[0];
+	state->zygote_pid = pid;
+
+	// replies are handled as they come in, see libkita_zygote_handle()
+	struct epoll_event epev = { .events = EPOLLIN, .data.u64 = (uint32_t) state->zygote };
+	epoll_ctl(state->epfd, EPOLL_CTL_ADD, state->zygote, &epev);
+	return 0;
+}
+
+/*
+ * Stops the zygote, if running, by closing our end of the socket, which
+ * makes it exit, then waits for it.
+ */
+static void
+libkita_zygote_stop(kita_state_s *state)
+{
+	if (state->zygote == -1)
+	{
+		return;
+	}
+
+	epoll_ctl(state->epfd, EPOLL_CTL_DEL, state->zygote, NULL);
+	close(state->zygote);
+	waitpid(state->zygote_pid, NULL, 0);
+	state->zygote     = -1;
+	state->zygote_pid = 0;
+}
+
+/*
+ * Sends a request to the zygote to create a process for the given child, 
+ * with pipes for those of stdin, stdout and stderr that are set in `ios`,
+ * then adds the child to the queue of children waiting for the zygote's 
+ * reply, see libkita_zygote_recv(). This doesn't wait for the zygote, so the
+ * caller can go on handling events while the child is being created. If the 
+ * zygote isn't responding or can't take any more requests right now, -1 is
+ * returned with errno set to ECHILD, so the caller can spawn by other means.
+ * Returns 0 if the request has been sent, -1 on error.
+ */
+static int
+libkita_zygote_send(kita_state_s *state, const kita_child_s *child, const int ios[3])
+{
+	char buf[KITA_ZYGOTE_BUF];
+	struct libkita_zygote_req req = {
+		.ios = { ios[0] != 0, ios[1] != 0, ios[2] != 0 },
+		.pgroup = child->group, .prio = child->prio
+	};
+	const char *exe  = child->exe;
+	char      **argv = child->argv;
+
+	// make sure there is room in the queue before anything is sent
+	if (state->num_spawning == state->cap_spawning)
+	{
+		size_t cap = state->cap_spawning ? state->cap_spawning * 2 : KITA_SLAB_SIZE;
+		kita_child_s **spawning = realloc(state->spawning, cap * sizeof(kita_child_s*));
+		if (spawning == NULL)
+		{
+			return -1;
+		}
+		state->spawning     = spawning;
+		state->cap_spawning = cap;
+	}
+
+	// the child gets our signal mask, minus SIGCHLD (see libkita_init_reaping)
+	sigprocmask(SIG_SETMASK, NULL, &req.mask);
+	sigdelset(&req.mask, SIGCHLD);
+
+	// pack executable and arguments, all null terminated
+	size_t len = sizeof(req);
+	size_t exe_len = strlen(exe) + 1;
+	if (len + exe_len > sizeof(buf) - 1)
+	{
+		errno = E2BIG;
+		return -1;
+	}
+	memcpy(buf + len, exe, exe_len);
+	len += exe_len;
+
+	for (char **arg = argv; *arg; ++arg, ++req.argc)
+	{
+		size_t arg_len = strlen(*arg) + 1;
+		if (len + arg_len > sizeof(buf) - 1)
+		{
+			errno = E2BIG;
+			return -1;
+		}
+		memcpy(buf + len, *arg, arg_len);
+		len += arg_len;
+	}
+	memcpy(buf, &req, sizeof(req));
+
+	// a zygote that went away will be noticed via its socket's hangup
+	if (send(state->zygote, buf, len, MSG_NOSIGNAL | MSG_DONTWAIT) == -1)
+	{
+		errno = ECHILD;
+		return -1;
+	}
+
+	state->spawning[state->num_spawning++] = (kita_child_s*) child;
+	return 0;
+}
+
+/*
+ * Receives one reply of the zygote, without blocking. The reply's PID will
+ * be written to `pid`, the file descriptors that came with it to `fds`, in 
+ * the order stdin, stdout, stderr, but only for those that were requested.
+ * Returns 1 if a reply was received, 0 if there is none (yet), -1 if the 
+ * zygote has gone away. If the zygote failed to create the process, `pid`
+ * will be -1 and errno will be set to the zygote's error.
+ */
+static int
+libkita_zygote_recv(kita_state_s *state, pid_t *pid, int fds[3])
+{
+	struct libkita_zygote_rep rep = { .pid = -1 };
+	struct iovec iov = { .iov_base = &rep, .iov_len = sizeof(rep) };
+	union {
+		char buf[CMSG_SPACE(sizeof(int) * 3)];
+		struct cmsghdr align;
+	} ctrl;
+	struct msghdr msg = {
+		.msg_iov = &iov, .msg_iovlen = 1,
+		.msg_control = ctrl.buf, .msg_controllen = sizeof(ctrl.buf)
+	};
+
+	ssize_t got;
+	while ((got = recvmsg(state->zygote, &msg, MSG_CMSG_CLOEXEC | MSG_DONTWAIT)) == -1 
+			&& errno == EINTR)
+	{
+		// retry
+	}
+	if (got == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+	{
+		return 0;
+	}
+	if (got < (ssize_t) sizeof(rep))
+	{
+		return -1;
+	}
+
+	fds[0] = fds[1] = fds[2] = -1;
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+	{
+		memcpy(fds, CMSG_DATA(cmsg), cmsg->cmsg_len - CMSG_LEN(0));
+	}
+
+	*pid = rep.pid;
+	errno = rep.err;
+	return 1;
+}
+
+/*
+ * Removes the given child from the queue of children waiting for the zygote.
+ * Its place stays, as the zygote's reply for it still has to be received;
+ * the process that comes with it will be killed, see libkita_zygote_done().
+ */
+static void
+libkita_zygote_cancel(kita_state_s *state, kita_child_s *child)
+{
+	for (size_t i = 0; i < state->num_spawning; ++i)
+	{
+		if (state->spawning[i] == child)
+		{
+			state->spawning[i] = NULL;
+		}
+	}
+	child->spawning = 0;
+}
+
+/*
+ * Examines the given file descriptor for the number of bytes available for 
+ * reading and returns that number. On error, -1 will be returned.
+ */
+static int
+libkita_fd_data_avail(int fd)
+{
+	int bytes = 0;
+	return ioctl(fd, FIONREAD, &bytes) == -1 ? -1 : bytes;
+}
+
+/*
+ * Returns the bucket of the pid hash table that the given `pid` maps to.
+ * `cap` needs to be a power of 2.
+ */
+static size_t
+libkita_pid_hash(pid_t pid, size_t cap)
+{
+	return ((size_t) pid * 2654435761u) & (cap - 1);
+}
+
+/*
+ * Doubles the size of the state's pid hash table and re-inserts all entries.
+ * Returns 0 on success, -1 if out of memory.
+ */
+static int
+libkita_pids_grow(kita_state_s *state)
+{
+	size_t cap = state->cap_pids ? state->cap_pids * 2 : KITA_PIDS_SIZE;
+	kita_child_s **pids = calloc(cap, sizeof(kita_child_s*));
+	if (pids == NULL)
+	{
+		return -1;
+	}
+
+	for (size_t i = 0; i < state->cap_pids; ++i)
+	{
+		if (state->pids[i] == NULL)
+		{
+			continue;
+		}
+		size_t b = libkita_pid_hash(state->pids[i]->pid, cap);
+		while (pids[b])
+		{
+			b = (b + 1) & (cap - 1);
+		}
+		pids[b] = state->pids[i];
+	}
+
+	free(state->pids);
+	state->pids = pids;
+	state->cap_pids = cap;
+	return 0;
+}
+
+/*
+ * Adds the given child to the state's pid hash table, using its current PID.
+ * Returns 0 on success, -1 on error.
+ */
+static int
+libkita_pids_put(kita_state_s *state, kita_child_s *child)
+{
+	if (child->pid <= 0)
+	{
+		return -1;
+	}
+
+	// keep the load factor at or below 1/2
+	if ((state->num_pids + 1) * 2 > state->cap_pids && libkita_pids_grow(state) == -1)
+	{
+		return -1;
+	}
+
+	size_t b = libkita_pid_hash(child->pid, state->cap_pids);
+	while (state->pids[b])
+	{
+		if (state->pids[b] == child)
+		{
+			return 0; // already in there
+		}
+		b = (b + 1) & (state->cap_pids - 1);
+	}
+	state->pids[b] = child;
+	++state->num_pids;
+	return 0;
+}
+
+/*
+ * Finds and returns the child with the given `pid` or NULL.
+ */
+static kita_child_s*
+libkita_child_get_by_pid(kita_state_s *state, pid_t pid)
+{
+	if (state->cap_pids == 0 || pid <= 0)
+	{
+		return NULL;
+	}
+
+	size_t b = libkita_pid_hash(pid, state->cap_pids);
+	while (state->pids[b])
+	{
+		if (state->pids[b]->pid == pid)
+		{
+			return state->pids[b];
+		}
+		b = (b + 1) & (state->cap_pids - 1);
+	}
+	return NULL;
+}
+
+/*
+ * Removes the given child from the state's pid hash table, if present. 
+ * This needs to happen before the child's PID is changed or reset.
+ */
+static void
+libkita_pids_del(kita_state_s *state, kita_child_s *child)
+{
+	if (state->cap_pids == 0 || child->pid <= 0)
+	{
+		return;
+	}
+
+	size_t mask = state->cap_pids - 1;
+	size_t i = libkita_pid_hash(child->pid, state->cap_pids);
+	while (state->pids[i] != child)
+	{
+		if (state->pids[i] == NULL)
+		{
+			return; // not in the table
+		}
+		i = (i + 1) & mask;
+	}
+
+	state->pids[i] = NULL;
+	--state->num_pids;
+
+	// shift following entries back, so that no lookup hits a gap early
+	size_t j = i;
+	while (state->pids[j = (j + 1) & mask])
+	{
+		size_t k = libkita_pid_hash(state->pids[j]->pid, state->cap_pids);
+		// entry may only move if its home bucket is not within (i, j]
+		if ((j > i && (k <= i || k > j)) || (j < i && (k <= i && k > j)))
+		{
+			state->pids[i] = state->pids[j];
+			state->pids[j] = NULL;
+			i = j;
+		}
+	}
+}
+
+/*
+ * Sets the entry for the given file descriptor in the state's fd lookup 
+ * table to `child`, growing the table if required. Use NULL as `child` 
+ * to clear the entry. Returns 0 on success, -1 on error.
+ */
+static int
+libkita_fds_set(kita_state_s *state, int fd, kita_child_s *child)
+{
+	if (fd < 0)
+	{
+		return -1;
+	}
+
+	if ((size_t) fd >= state->num_fds)
+	{
+		if (child == NULL)
+		{
+			return 0; // nothing to clear
+		}
+
+		size_t num = state->num_fds ? state->num_fds : KITA_FDS_SIZE;
+		while (num <= (size_t) fd)
+		{
+			num *= 2;
+		}
+
+		kita_child_s **fds = realloc(state->fds, num * sizeof(kita_child_s*));
+		if (fds == NULL)
+		{
+			return -1;
+		}
+		for (size_t i = state->num_fds; i < num; ++i)
+		{
+			fds[i] = NULL;
+		}
+		state->fds = fds;
+		state->num_fds = num;
+	}
+
+	state->fds[fd] = child;
+	return 0;
+}
+
+static kita_child_s*
+libkita_child_get_by_fd(kita_state_s *state, int fd)
+{
+	if (fd < 0 || (size_t) fd >= state->num_fds)
+	{
+		return NULL;
+	}
+	return state->fds[fd];
+}
+
+static kita_ios_type_e
+libkita_child_fd_get_type(kita_child_s *child, int fd)
+{
+	for (int i = 0; i < 3; ++i)
+	{
+		if (child->io[i] && child->io[i]->fd == fd)
+		{
+			return (kita_ios_type_e) i;
+		}
+	}
+	return -1;
+}
+
+/*
+ * Sets the buffer type of the stream, which determines how data is read from
+ * it: line by line (KITA_BUF_LINE) or in chunks (KITA_BUF_NONE, _FULL).
+ */
+static int
+libkita_stream_set_buf_type(kita_stream_s *stream, kita_buf_type_e buf)
+{
+	stream->buf_type = buf;
+	return 0;
+}
+
+/*
+ * Hands out a new tag for registering `fd` with epoll, stores it in `tag` and
+ * returns the epoll data for the registration: the fd, plus the tag, which
+ * tells events for the fd apart from those for an earlier fd of the same 
+ * number, that was closed while the events were handled. Tag 0 is left to 
+ * fds that are checked by number before any lookup (timerfd, signalfd, the
+ * zygote's socket), so an event with tag 0 never matches any other fd.
+ */
+static uint64_t
+libkita_tag(kita_state_s *state, int fd, uint32_t *tag)
+{
+	if (++state->tags == 0)
+	{
+		++state->tags;
+	}
+	*tag = state->tags;
+	return ((uint64_t) *tag << 32) | (uint32_t) fd;
+}
+
+/*
+ * Register the given stream's file descriptor with the state's epoll instance
+ * and make it known to the state's fd lookup table as belonging to `child`.
+ */
+static int
+libkita_stream_reg_ev(kita_state_s *state, kita_child_s *child, kita_stream_s *stream)
+{
+	if (stream->fd == -1) // we don't register a closed stream
+	{
+		return -1;
+	}
+
+	int fd = stream->fd;
+	int ev = stream->ios_type == KITA_IOS_IN ? EPOLLOUT : EPOLLIN;
+
+	struct epoll_event epev = { .events = ev | EPOLLET, 
+		.data.u64 = libkita_tag(state, fd, &stream->tag) };
+	
+	if (epoll_ctl(state->epfd, EPOLL_CTL_ADD, fd, &epev) == 0)
+	{
+		stream->registered = 1;
+		libkita_fds_set(state, fd, child);
+		return 0;
+	}
+	return -1;
+}
+
+/*
+ * Remove the given stream's file descriptor from the state's epoll instance
+ * and from the state's fd lookup table.
+ */
+static int
+libkita_stream_rem_ev(kita_state_s *state, kita_stream_s *stream)
+{
+	libkita_fds_set(state, stream->fd, NULL);
+	if (epoll_ctl(state->epfd, EPOLL_CTL_DEL, stream->fd, NULL) == 0)
+	{
+		stream->registered = 0;
+		return 0;
+	}
+	return -1;
+}
+
+/*
+ * Register all events for the given child with the epoll file descriptor.
+ * Returns the number of events registered.
+ */
+static int 
+libkita_child_reg_events(kita_state_s *state, kita_child_s *child)
+{
+	int reg = 0;
+	for (int i = 0; i < 3; ++i)
+	{
+		if (child->io[i])
+		{
+			reg += libkita_stream_reg_ev(state, child, child->io[i]) == 0;
+		}
+	}
+	return reg;
+}
+
+/*
+ * Removes all events for the given child from the epoll file descriptor.
+ * Returns the number of events deleted.
+ */
+static int
+libkita_child_rem_events(kita_state_s *state, kita_child_s *child)
+{
+	int rem = 0;
+	for (int i = 0; i < 3; ++i)
+	{
+		if (child->io[i])
+		{
+			rem += libkita_stream_rem_ev(state, child->io[i]) == 0;
+		}
+	}
+	return rem;
+}
+
+/*
+ * Discards all input that is waiting to be written to the given stream.
+ * If `state` is given, the discarded inputs are counted as dropped.
+ */
+static void
+libkita_stream_discard(kita_state_s *state, kita_stream_s *stream)
+{
+	if (state)
+	{
+		state->stats.dropped += (stream->out != NULL) + (stream->next != NULL);
+	}
+
+	free(stream->out);
+	free(stream->next);
+	stream->out  = NULL;
+	stream->next = NULL;
+}
+
+/*
+ * Closes the given stream's file descriptor and discards buffered data,
+ * including input not yet written, which will be counted as dropped in
+ * the given `state`, if any.
+ * Returns 0 on success, -1 if the stream wasn't open in the first place.
+ */
+static int
+libkita_stream_close(kita_state_s *state, kita_stream_s *stream)
+{
+	libkita_stream_discard(state, stream);
+	stream->len  = 0;
+	stream->hold = 0;
+	stream->skip = 0;
+
+	if (stream->fd == -1)
+	{
+		return -1;
+	}
+
+	close(stream->fd);
+	stream->fd = -1;
+	return 0;
+}
+
+/*
+ * Create a kita_stream_s struct on the heap (malloc'd) and 
+ * initialize it to the given stream type `ios` and buffer type `buf`. 
+ * Returns the allocated structure or NULL if out of memory.
+ */
+static kita_stream_s*
+libkita_stream_new(kita_ios_type_e ios)
+{
+	kita_stream_s *stream = malloc(sizeof(kita_stream_s));
+	if (stream == NULL)
+	{
+		return NULL;
+	}
+	*stream = (kita_stream_s) { 0 };
+
+	// file descriptor
+	stream->fd = -1;
+	
+	// set stream type and stream buffer type
+	stream->ios_type = ios;
+	stream->buf_type = (ios == KITA_IOS_ERR) ? KITA_BUF_NONE : KITA_BUF_LINE;
+
+	return stream;
+}
+
+/*
+ * Set the blocking behavior of the given stream, where 0 means non-blocking 
+ * and 1 means blocking. Returns 0 on success, -1 on error.
+ */
+int
+libkita_stream_set_blocking(kita_stream_s *stream, int blocking)
+{
+	if (stream->fd == -1) // can't modify if not yet open
+	{
+		return -1;
+	}
+
+	// one syscall, instead of reading and then writing the flags via fcntl()
+	int nonblocking = !blocking;
+	return ioctl(stream->fd, FIONBIO, &nonblocking) == -1 ? -1 : 0;
+}
+
+/*
+ * Splits the given command into arguments via wordexp(), which also takes care
+ * of quotes, variables and the like. Returns a NULL terminated array of the 
+ * arguments, with two spare slots at the end, one of which is reserved for an
+ * additional argument. The number of arguments is returned in `argc`. 
+ * Returns NULL on error, or if the command didn't yield any arguments.
+ */
+static char**
+libkita_split_cmd(const char *cmd, size_t *argc)
+{
+	if (libkita_empty(cmd))
+	{
+		return NULL;
+	}
+
+	wordexp_t p;
+	if (wordexp(cmd, &p, 0) != 0)
+	{
+		return NULL;
+	}
+
+	char **argv = NULL;
+	if (p.we_wordc > 0 && (argv = malloc(sizeof(char*) * (p.we_wordc + 2))))
+	{
+		for (size_t i = 0; i < p.we_wordc; ++i)
+		{
+			argv[i] = strdup(p.we_wordv[i]);
+		}
+		argv[p.we_wordc] = argv[p.we_wordc + 1] = NULL;
+		*argc = p.we_wordc;
+	}
+	wordfree(&p);
+	return argv;
+}
+
+/*
+ * Finds the executable `name` in the directories listed in `path`, which 
+ * should be in the format of the PATH environment variable, the same way 
+ * execvp() would. If `name` contains a slash, it is used as-is. If `path` is
+ * NULL, a default will be used. Returns the path of the executable as a 
+ * dynamically allocated string or NULL if it couldn't be found.
+ */
+static char*
+libkita_which(const char *name, const char *path)
+{
+	if (strchr(name, '/'))
+	{
+		return strdup(name);
+	}
+
+	if (path == NULL)
+	{
+		path = "/bin:/usr/bin";
+	}
+
+	size_t name_len = strlen(name);
+	while (1)
+	{
+		const char *end = strchr(path, ':');
+		size_t dir_len = end ? (size_t) (end - path) : strlen(path);
+
+		// an empty entry means the current working directory
+		char *exe = malloc(dir_len + name_len + 3);
+		if (exe == NULL)
+		{
+			return NULL;
+		}
+		snprintf(exe, dir_len + name_len + 3, "%.*s/%s", 
+				(int) (dir_len ? dir_len : 1), dir_len ? path : ".", name);
+
+		struct stat sb;
+		if (stat(exe, &sb) == 0 && S_ISREG(sb.st_mode) && access(exe, X_OK) == 0)
+		{
+			return exe;
+		}
+		free(exe);
+
+		if (end == NULL)
+		{
+			return NULL;
+		}
+		path = end + 1;
+	}
+}
+
+/*
+ * Makes sure the child's executable has been resolved to a path. This only
+ * happens again if the PATH environment variable has changed since the last
+ * time. Returns 0 on success, -1 if the executable couldn't be found.
+ */
+static int
+libkita_child_resolve(kita_child_s *child)
+{
+	const char *path = getenv("PATH");
+
+	if (child->exe)
+	{
+		int same = (path == NULL && child->exe_env == NULL) ||
+			(path && child->exe_env && strcmp(path, child->exe_env) == 0);
+		if (same)
+		{
+			return 0;
+		}
+	}
+
+	free(child->exe);
+	free(child->exe_env);
+	child->exe     = libkita_which(child->argv[0], path);
+	child->exe_env = path ? strdup(path) : NULL;
+
+	return child->exe ? 0 : -1;
+}
+
+/*
+ * Runs the child's executable via libkita_popen(), with pipes for all of the
+ * child's streams, using the given `spawn` method. Returns the child's PID
+ * or -1 on error.
+ */
+static pid_t
+libkita_child_popen(kita_child_s *child, kita_spawn_type_e spawn)
+{
+	int *in  = child->io[KITA_IOS_IN]  ? &child->io[KITA_IOS_IN]->fd  : NULL;
+	int *out = child->io[KITA_IOS_OUT] ? &child->io[KITA_IOS_OUT]->fd : NULL;
+	int *err = child->io[KITA_IOS_ERR] ? &child->io[KITA_IOS_ERR]->fd : NULL;
+
+	// The additional argument, if any, is passed on as-is, as one argument
+	child->argv[child->argc] = libkita_empty(child->arg) ? NULL : child->arg;
+	pid_t pid = libkita_popen(child, in, out, err, spawn);
+	child->argv[child->argc] = NULL;
+	return pid;
+}
+
+/*
+ * Runs the child. Returns 0 if the child is running, 1 if it has been handed
+ * to the zygote, which will create it later on, see libkita_zygote_done(),
+ * or -1 on error.
+ */
+static int
+libkita_child_open(kita_child_s *child)
 {
-	if (child->pid > 0) 
+	if (child->pid > 0 || child->spawning) 
 	{
 		// ALREADY OPEN
 		return -1;
 	}
 
-	if (libkita_empty(child->cmd))
+	if (child->argv == NULL)
 	{
-		// NO COMMAND GIVEN
+		// NO COMMAND GIVEN (or it couldn't be expanded)
 		return -1;
 	}
 
-	// Construct the command, if there is an additional argument string
-	char *cmd = NULL;
-	if (child->arg)
+	if (libkita_child_resolve(child) == -1)
 	{
-		size_t len = strlen(child->cmd) + strlen(child->arg) + 4;
-		cmd = malloc(sizeof(char) * len);
-		snprintf(cmd, len, "%s %s", child->cmd, child->arg);
+		// EXECUTABLE NOT FOUND
+		return -1;
 	}
-	
+
+	kita_state_s *state = child->state;
+	kita_spawn_type_e spawn = state ? state->spawn : KITA_SPAWN_FORK;
+
+	// Have the zygote create the child, if we have one, without waiting
+	if (spawn == KITA_SPAWN_ZYGOTE && state->zygote != -1)
+	{
+		int ios[3] = { child->io[0] != NULL, child->io[1] != NULL, child->io[2] != NULL };
+
+		child->argv[child->argc] = libkita_empty(child->arg) ? NULL : child->arg;
+		int sent = libkita_zygote_send(state, child, ios);
+		child->argv[child->argc] = NULL;
+
+		if (sent == 0)
+		{
+			child->spawning = 1;
+			return 1;
+		}
+		if (errno != ECHILD)
+		{
+			return -1;
+		}
+	}
+
 	// Execute the block and retrieve its PID
-	child->pid = libkita_popen(
-			cmd ? cmd : child->cmd, 
-			child->io[KITA_IOS_IN]  ? &child->io[KITA_IOS_IN]->fp  : NULL,
-			child->io[KITA_IOS_OUT] ? &child->io[KITA_IOS_OUT]->fp : NULL,
-		        child->io[KITA_IOS_ERR] ? &child->io[KITA_IOS_ERR]->fp : NULL);
-	free(cmd);
+	child->pid = libkita_child_popen(child, spawn);
 
 	// Check if that worked
 	if (child->pid == -1)
@@ -646,20 +1760,7 @@ libkita_child_open(kita_child_s *child)
 		// popen_noshell() failed to open it
 		return -1;
 	}
-	
-	// Get file descriptors from open file pointers
-	// and make sure the streams have the correct buffer type
-	for (int i = 0; i < 3; ++i)
-	{
-		if (child->io[i] && child->io[i]->fp)
-		{
-			child->io[i]->fd = fileno(child->io[i]->fp);
-			libkita_stream_set_buf_type(child->io[i], child->io[i]->buf_type);
-			// TODO wouldn't it be best to set non-blocking right here?
-			//libkita_stream_set_blocking(child->io[i], 0);
-		}
-	}
-	
+
 	return 0;
 }
 
@@ -675,151 +1776,407 @@ libkita_child_close(kita_child_s *child)
 	{
 		if (child->io[i] != NULL)
 		{
-			num_closed += (libkita_stream_close(child->io[i]) == 0);
+			num_closed += (libkita_stream_close(child->state, child->io[i]) == 0);
 		}
 	}
 	return num_closed;
 }
 
-static size_t
-libkita_child_add(kita_state_s *state, kita_child_s *child)
+/*
+ * Grows the state's child slab, making new free slots available.
+ * Existing slots keep their index. Returns 0 on success, -1 on error.
+ */
+static int
+libkita_slab_grow(kita_state_s *state)
 {
-	// array index for the new child
-	int idx = state->num_children++;
+	size_t cap = state->cap_children ? state->cap_children * 2 : KITA_SLAB_SIZE;
 
-	// increase array size
-	size_t new_size = state->num_children * sizeof(state->children);
-	kita_child_s** children = realloc(state->children, new_size);
+	kita_child_s **children = realloc(state->children, cap * sizeof(kita_child_s*));
 	if (children == NULL)
 	{
-		return --state->num_children;
+		return -1;
 	}
 	state->children = children;
 
-	// add new child
-	state->children[idx] = child;
+	size_t *free_slots = realloc(state->free_slots, cap * sizeof(size_t));
+	if (free_slots == NULL)
+	{
+		return -1;
+	}
+	state->free_slots = free_slots;
+
+	// push the new slots onto the free stack, lowest index on top
+	for (size_t i = cap; i > state->cap_children; --i)
+	{
+		state->children[i - 1] = NULL;
+		state->free_slots[state->num_free++] = i - 1;
+	}
+	state->cap_children = cap;
+	return 0;
+}
+
+/*
+ * Adds the child to the state, taking a slot from the free list. The slab 
+ * is only grown if there are no free slots left; adding a child to a state
+ * that has had children removed before does not allocate any memory.
+ * Returns the new number of children tracked by the state.
+ */
+static size_t
+libkita_child_add(kita_state_s *state, kita_child_s *child)
+{
+	// make sure we have a free slot
+	if (state->num_free == 0 && libkita_slab_grow(state) == -1)
+	{
+		return state->num_children;
+	}
+
+	// add new child to the next free slot
+	size_t slot = state->free_slots[--state->num_free];
+	state->children[slot] = child;
+	child->slot = slot;
+
+	// mark new child as tracked
+	child->state = state;
+
+	// make the child findable by its PID, in case it is running already
+	libkita_pids_put(state, child);
+
+	// return new number of children
+	return ++state->num_children;
+}
+
+/*
+ * Removes this child from the state. The child will not be stopped or closed,
+ * nor will its events be deleted from the state's epoll instance. The child's
+ * slot will be put back onto the free list, no memory is being released.
+ * Returns the new number of children tracked by the state.
+ */
+static size_t
+libkita_child_del(kita_state_s *state, kita_child_s *child)
+{
+	// make sure the child actually occupies the slot it thinks it does
+	if (child->slot >= state->cap_children || state->children[child->slot] != child)
+	{
+		// child not found, do nothing
+		return state->num_children;
+	}
+
+	// remove the child from the pid hash table
+	libkita_pids_del(state, child);
+
+	// free up the slot 
+	state->children[child->slot] = NULL;
+	state->free_slots[state->num_free++] = child->slot;
+
+	// remove state reference from child
+	child->state = NULL;
+
+	return --state->num_children;
+}
+
+/*
+ * Init the epoll instance for the given state.
+ * Returns 0 on success, -1 on error.
+ */
+static int
+libkita_init_epoll(kita_state_s *state)
+{
+	int epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (epfd < 0)
+	{
+		return -1;
+	}
+	state->epfd = epfd;
+	return 0;
+}
+
+static int
+libkita_dispatch_event(kita_state_s *state, kita_event_s *event)
+{
+	if (state->cbs[event->type] == NULL)
+	{
+		return -1;
+	}
+	state->cbs[event->type](state, event);
+	return 0;
+}
+
+/*
+ * Uses waitid() to figure out if the given child is alive or dead.
+ * Returns 1 if child is alive, 0 if dead, -1 if status is unknown.
+ */ 
+static int
+libkita_child_status(kita_child_s *child)
+{
+	siginfo_t info = { 0 };
+	int options = WEXITED | WSTOPPED | WNOHANG | WNOWAIT;
+	if (waitid(P_PID, child->pid, &info , options) == -1)
+	{
+		// waitid() error, status unknown
+		return -1;
+	}
+	if (info.si_pid == 0) 
+	{
+		// no state change for PID, still running
+ 		return 1;
+	}
+	// we don't need to inspect info.si_code, because
+	// we only wait for exited/stopped children anyway
+	return 0;
+}
+
+/*
+ * Opens a pidfd for the given (tracked and running) child and registers it 
+ * with the state's epoll instance, so that we will be notified as soon as 
+ * the child exits. If that fails, the child will be picked up by a waitpid() 
+ * sweep instead. Returns 0 on success, -1 on error.
+ */
+static int
+libkita_pidfd_open(kita_state_s *state, kita_child_s *child)
+{
+	// in fallback mode, all children are reaped via SIGCHLD/signalfd
+	if (state->sigfd != -1)
+	{
+		return -1;
+	}
+
+	child->pidfd = syscall(SYS_pidfd_open, child->pid, 0);
+	if (child->pidfd == -1)
+	{
+		++state->num_unwatched;
+		return -1;
+	}
+
+	struct epoll_event epev = { .events = EPOLLIN, 
+		.data.u64 = libkita_tag(state, child->pidfd, &child->pidfd_tag) };
+	if (epoll_ctl(state->epfd, EPOLL_CTL_ADD, child->pidfd, &epev) == -1)
+	{
+		close(child->pidfd);
+		child->pidfd = -1;
+		++state->num_unwatched;
+		return -1;
+	}
+
+	libkita_fds_set(state, child->pidfd, child);
+	return 0;
+}
+
+/*
+ * Unregisters and closes the child's pidfd, if it has one.
+ */
+static void
+libkita_pidfd_close(kita_state_s *state, kita_child_s *child)
+{
+	if (child->pidfd == -1)
+	{
+		if (child->pid > 0 && state->num_unwatched)
+		{
+			--state->num_unwatched;
+		}
+		return;
+	}
+
+	libkita_fds_set(state, child->pidfd, NULL);
+	epoll_ctl(state->epfd, EPOLL_CTL_DEL, child->pidfd, NULL);
+	close(child->pidfd);
+	child->pidfd = -1;
+}
+
+/*
+ * Returns 1 if the stream has data waiting to be read, either in the pipe or
+ * as an incomplete line in the stream's buffer, otherwise 0.
+ */
+static int
+libkita_stream_pending(kita_stream_s *stream)
+{
+	if (stream->fd == -1)
+	{
+		return 0;
+	}
+	return stream->len > stream->hold || libkita_fd_data_avail(stream->fd) > 0;
+}
+
+/*
+ * Writes `len` bytes of `data` to the stream's file descriptor, stopping
+ * early if the write would block. Returns the number of bytes written,
+ * or -1 on error.
+ */
+static ssize_t
+libkita_stream_write(kita_stream_s *stream, const char *data, size_t len)
+{
+	size_t done = 0;
+	while (done < len)
+	{
+		ssize_t n = write(stream->fd, data + done, len - done);
+		if (n == -1)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+			{
+				break;
+			}
+			return -1;
+		}
+		done += n;
+	}
+	return done;
+}
+
+/*
+ * Writes as much of the input queued for the stream as possible without
+ * blocking: first the remainder of the partially written input, if any, then
+ * the newest input, if any. On error, all queued input will be discarded.
+ * Returns 0 if everything has been written, 1 if some input is still queued
+ * (the child isn't reading fast enough) and -1 on error.
+ */
+static int
+libkita_stream_flush(kita_state_s *state, kita_stream_s *stream)
+{
+	if (stream->fd == -1)
+	{
+		libkita_stream_discard(state, stream);
+		return -1;
+	}
+
+	for (;;)
+	{
+		// partially written input done, start on the newest one, if any
+		if (stream->out == NULL)
+		{
+			if (stream->next == NULL)
+			{
+				return 0;
+			}
+			stream->out     = stream->next;
+			stream->out_len = strlen(stream->next);
+			stream->out_off = 0;
+			stream->next    = NULL;
+		}
+
+		char  *from = stream->out + stream->out_off;
+		size_t left = stream->out_len - stream->out_off;
+		ssize_t n = libkita_stream_write(stream, from, left);
+
+		if (n == -1)
+		{
+			libkita_stream_discard(state, stream);
+			return -1;
+		}
 
-	// mark new child as tracked
-	state->children[idx]->state = state;
+		stream->out_off += n;
+		if (stream->out_off < stream->out_len)
+		{
+			return 1;
+		}
 
-	// return new number of children
-	return state->num_children;
+		free(stream->out);
+		stream->out = NULL;
+	}
 }
 
 /*
- * Removes this child from the state. The child will not be stopped or closed,
- * nor will its events be deleted from the state's epoll instance. 
- * Returns the new number of children tracked by the state.
+ * Dispatches READOK events for the child's output streams that still have
+ * data waiting, so that user code gets to see the last output of a child 
+ * that has exited before we close its streams.
  */
-static size_t
-libkita_child_del(kita_state_s *state, kita_child_s *child)
+static void
+libkita_child_drain(kita_state_s *state, kita_child_s *child)
 {
-	// find the array index of the given child
-	int idx = libkita_child_get_idx(state, child);
-	if (idx < 0)
+	for (int i = KITA_IOS_OUT; i <= KITA_IOS_ERR; ++i)
 	{
-		// child not found, do nothing
-		return state->num_children;
+		if (child->io[i] == NULL || libkita_stream_pending(child->io[i]) == 0)
+		{
+			continue;
+		}
+
+		kita_event_s event = { 0 };
+		event.child = child;
+		event.type  = KITA_EVT_CHILD_READOK;
+		event.ios   = (kita_ios_type_e) i;
+		event.fd    = child->io[i]->fd;
+		event.size  = -1;
+		libkita_dispatch_event(state, &event);
 	}
+}
 
-	// remove state reference from child
-	child->state = NULL;
+/*
+ * Takes care of a child that has exited and has been waited for, with the
+ * given `status` as returned by waitpid(). Remaining output will be handed
+ * to user code, then the child will be closed (by closing all of its streams) 
+ * and its PID will be reset to 0. The EXITED, CLOSED and REAPED events will be 
+ * dispatched in that order. REAPED is the last event for this run of the child
+ * and kita will not touch the child afterwards, so the REAPED callback is free 
+ * to remove or even free the child.
+ */
+static void
+libkita_reap_child(kita_state_s *state, kita_child_s *child, int status)
+{
+	// remember the time of death and the child's waitpid status
+	clock_gettime(CLOCK_MONOTONIC, &child->exited);
+	child->status = status;
 
-	// reduce child counter by one
-	--state->num_children;
+	// let user code read whatever the child left in its pipes
+	libkita_child_drain(state, child);
 
-	// copy the ptr to the last element into this element
-	if (state->num_children != idx)
-	{
-		state->children[idx] = state->children[state->num_children];
-		state->children[state->num_children] = NULL;
-	}
+	// prepare the event struct
+	kita_event_s event = { 0 };
+	event.child = child;
+	event.ios   = KITA_IOS_ALL;
+	event.fd    = -1;
 
-	// figure out the new size
-	size_t new_size = state->num_children * sizeof(state->children);
+	// dispatch exit event
+	event.type  = KITA_EVT_CHILD_EXITED;
+	libkita_dispatch_event(state, &event);
 
-	// if we deleted the last element, just use free() and return
-	if (new_size == 0)
-	{
-		free(state->children);
-		return 0;
-	}
+	// remove epoll events, including the pidfd, if any
+	libkita_pidfd_close(state, child);
+	libkita_child_rem_events(state, child);
 
-	// realloc() the array to the new size
-	kita_child_s** children = realloc(state->children, new_size);
-	
-	// in case realloc failed...
-	if (children == NULL)
-	{
-		// realloc() failed, which means we're stuck with the old 
-		// memory, which is too large by one element and now has 
-		// a duplicate element (the last one and the one at `idx`),
-		// which is annoying, but if we pretend the size to be one 
-		// smaller than it actually is, then we should never find 
-		// ourselves accidentally trying to access that last element;
-		// and hopefully the next realloc() will succeed and fix it.
-		return state->num_children; 
-	}
+	// close the child's streams
+	libkita_child_close(child); 
 
-	state->children = children;
-	return state->num_children;
+	// set the PID to 0
+	libkita_pids_del(state, child);
+	child->pid = 0;
+
+	// dispatch close event
+	event.type  = KITA_EVT_CHILD_CLOSED;
+	libkita_dispatch_event(state, &event);
+
+	// dispatch reap event
+	event.type  = KITA_EVT_CHILD_REAPED;
+	libkita_dispatch_event(state, &event);
 }
 
 /*
- * Init the epoll instance for the given state.
- * Returns 0 on success, -1 on error.
+ * Reaps the given child, whose pidfd has become readable, via waitpid().
+ * Returns 1 if the child was reaped, 0 if it is still running.
  */
 static int
-libkita_init_epoll(kita_state_s *state)
+libkita_reap_pidfd(kita_state_s *state, kita_child_s *child)
 {
-	int epfd = epoll_create(1);
-	if (epfd < 0)
-	{
-		return -1;
-	}
-	state->epfd = epfd;
-	return 0;
-}
+	int status = 0;
+	pid_t pid = waitpid(child->pid, &status, WNOHANG);
 
-static int
-libkita_dispatch_event(kita_state_s *state, kita_event_s *event)
-{
-	if (state->cbs[event->type] == NULL)
+	// still running (stale event for a recycled file descriptor?)
+	if (pid == 0)
 	{
-		return -1;
+		return 0;
 	}
-	state->cbs[event->type](state, event);
-	return 0;
-}
 
-/*
- * Uses waitid() to figure out if the given child is alive or dead.
- * Returns 1 if child is alive, 0 if dead, -1 if status is unknown.
- */ 
-static int
-libkita_child_status(kita_child_s *child)
-{
-	siginfo_t info = { 0 };
-	int options = WEXITED | WSTOPPED | WNOHANG | WNOWAIT;
-	if (waitid(P_PID, child->pid, &info , options) == -1)
-	{
-		// waitid() error, status unknown
-		return -1;
-	}
-	if (info.si_pid == 0) 
-	{
-		// no state change for PID, still running
- 		return 1;
-	}
-	// we don't need to inspect info.si_code, because
-	// we only wait for exited/stopped children anyway
-	return 0;
+	// pid == -1 means we can't wait for it (someone else did), but 
+	// the pidfd being readable still tells us that the child is gone
+	libkita_reap_child(state, child, pid == -1 ? 0 : status);
+	return 1;
 }
 
 /*
  * Uses waitpid() to identify children that have died. Dead children will be 
- * closed (by closing all of their streams) and their PID will be reset to 0. 
- * The REAPED event will be dispatched for each child reaped this way.
+ * reaped via libkita_reap_child(). This is only needed for children that 
+ * aren't watched via a pidfd; it is called when the SIGCHLD signalfd fires.
  * Returns the number of reaped children.
  */
 static int
@@ -833,40 +2190,100 @@ libkita_reap(kita_state_s *state)
 	int reaped = 0;
 	pid_t pid  = 0;
 	int status = 0;
+
+	// while the zygote is creating children, we might not know their PIDs 
+	// yet, so we only wait for those that we do know, one by one
+	if (state->num_spawning)
+	{
+		for (size_t i = 0; i < state->cap_children; ++i)
+		{
+			kita_child_s *child = state->children[i];
+			if (child && child->pid > 0 && waitpid(child->pid, &status, WNOHANG) > 0)
+			{
+				libkita_reap_child(state, child, status);
+				++reaped;
+			}
+		}
+		return reaped;
+	}
+
 	while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
 	{
 		kita_child_s *child = libkita_child_get_by_pid(state, pid);
 		if (child)
 		{
-			// remember the child's waitpid status
-			child->status = status;
+			libkita_reap_child(state, child, status);
+			++reaped;
+		}
+	}
+	return reaped;
+}
 
-			// remove epoll events
-			libkita_child_rem_events(state, child);
+/*
+ * Reads and discards all pending signal info from the state's signalfd.
+ */
+static void
+libkita_sigfd_drain(kita_state_s *state)
+{
+	struct signalfd_siginfo info;
+	while (read(state->sigfd, &info, sizeof(info)) == sizeof(info))
+	{
+		// SIGCHLD is not queued, so we reap all children anyway
+	}
+}
 
-			// close the child's streams
-			libkita_child_close(child); 
+/*
+ * Creates the state's timerfd and registers it with the epoll instance.
+ * Returns 0 on success, -1 on error.
+ */
+static int
+libkita_init_timer(kita_state_s *state)
+{
+	state->tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (state->tfd == -1)
+	{
+		return -1;
+	}
 
-			// prepare the event struct
-			kita_event_s event = { 0 };
-			event.child = child;
-			event.ios   = KITA_IOS_ALL;
+	struct epoll_event epev = { .events = EPOLLIN, .data.u64 = (uint32_t) state->tfd };
+	return epoll_ctl(state->epfd, EPOLL_CTL_ADD, state->tfd, &epev);
+}
 
-			// dispatch close event
-			event.type  = KITA_EVT_CHILD_CLOSED;
-			libkita_dispatch_event(state, &event);
+/*
+ * Decides how child deaths will be detected: if the kernel supports pidfds, 
+ * every tracked child gets one. Otherwise, SIGCHLD will be blocked and read 
+ * via a signalfd instead, which triggers a waitpid() sweep whenever it fires.
+ * Returns 0 on success, -1 on error.
+ */
+static int
+libkita_init_reaping(kita_state_s *state)
+{
+	state->sigfd = -1;
 
-			// dispatch reap event
-			event.type  = KITA_EVT_CHILD_REAPED;
-			libkita_dispatch_event(state, &event);
+	// see if we can open a pidfd (for ourselves)
+	int pidfd = syscall(SYS_pidfd_open, getpid(), 0);
+	if (pidfd != -1)
+	{
+		close(pidfd);
+		return 0;
+	}
 
-			// finally, set the PID to 0
-			child->pid = 0;
+	sigset_t sigset;
+	sigemptyset(&sigset);
+	sigaddset(&sigset, SIGCHLD);
+	if (sigprocmask(SIG_BLOCK, &sigset, NULL) == -1)
+	{
+		return -1;
+	}
 
-			++reaped;
-		}
+	state->sigfd = signalfd(-1, &sigset, SFD_NONBLOCK | SFD_CLOEXEC);
+	if (state->sigfd == -1)
+	{
+		return -1;
 	}
-	return reaped;
+
+	struct epoll_event epev = { .events = EPOLLIN, .data.u64 = (uint32_t) state->sigfd };
+	return epoll_ctl(state->epfd, EPOLL_CTL_ADD, state->sigfd, &epev);
 }
 
 /*
@@ -876,9 +2293,10 @@ libkita_reap(kita_state_s *state)
 static size_t
 libkita_autoclean(kita_state_s *state)
 {
-	for (size_t i = 0; i < state->num_children; ++i)
+	for (size_t i = 0; i < state->cap_children; ++i)
 	{
-		if (state->children[i]->pid == 0)
+		if (state->children[i] && state->children[i]->pid == 0 
+				&& !state->children[i]->spawning)
 		{
 			// TODO
 			// we need to send the REMOVE event _before_ we actually 
@@ -915,9 +2333,9 @@ static int
 libkita_autoterm(kita_state_s *state)
 {
 	int terminated = 0;
-	for (size_t i = 0; i < state->num_children; ++i)
+	for (size_t i = 0; i < state->cap_children; ++i)
 	{
-		if (kita_child_is_open(state->children[i]) == 0)
+		if (state->children[i] && kita_child_is_open(state->children[i]) == 0)
 		{
 			terminated += (kita_child_term(state->children[i]) == 0);
 		}
@@ -925,34 +2343,272 @@ libkita_autoterm(kita_state_s *state)
 	return terminated;
 }
 
+/*
+ * Finishes opening a child whose process has just been created: makes its 
+ * streams non-blocking and, if the child is tracked, registers its events, 
+ * indexes its PID and opens its pidfd. Input that was fed to the child while
+ * the zygote was still creating it will be written now.
+ */
+static void
+libkita_child_started(kita_child_s *child)
+{
+	// make all streams non-blocking, feeding is queued, see kita_child_feed();
+	// the pipes can't be created non-blocking, the child's ends would be, too
+	if (child->io[KITA_IOS_IN])
+	{
+		libkita_stream_set_blocking(child->io[KITA_IOS_IN], 0);
+	}
+	if (child->io[KITA_IOS_OUT])
+	{
+		libkita_stream_set_blocking(child->io[KITA_IOS_OUT], 0);
+	}
+	if (child->io[KITA_IOS_ERR])
+	{
+		libkita_stream_set_blocking(child->io[KITA_IOS_ERR], 0);
+	}
+
+#ifdef F_SETPIPE_SZ
+	// a bigger pipe lets the child write more before it has to wait for us
+	if (child->io[KITA_IOS_OUT] && child->pipe_size > 0)
+	{
+		fcntl(child->io[KITA_IOS_OUT]->fd, F_SETPIPE_SZ, child->pipe_size);
+	}
+#endif
+
+	// if child is tracked, register events for it and index its PID
+	if (child->state)
+	{
+		libkita_child_reg_events(child->state, child);
+		libkita_pids_put(child->state, child);
+		libkita_pidfd_open(child->state, child);
+	}
+
+	if (child->io[KITA_IOS_IN] && child->io[KITA_IOS_IN]->next)
+	{
+		libkita_stream_flush(child->state, child->io[KITA_IOS_IN]);
+	}
+}
+
+/*
+ * Finishes what the zygote has started for the given child, with the `pid` 
+ * and file descriptors (see libkita_zygote_recv()) it replied with. If the 
+ * zygote failed, the child will be created directly instead; if that fails
+ * as well, the child is treated as if it had exited with status 127, like
+ * a shell does for commands it can't run, so user code gets the same events
+ * as for any other run. If the child has been removed in the meantime, the
+ * process is killed right away.
+ */
+static void
+libkita_zygote_done(kita_state_s *state, kita_child_s *child, pid_t pid, int fds[3])
+{
+	if (child == NULL)
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			if (fds[i] != -1)
+			{
+				close(fds[i]);
+			}
+		}
+		if (pid > 0)
+		{
+			kill(pid, SIGKILL);
+			waitpid(pid, NULL, 0);
+		}
+		return;
+	}
+
+	child->spawning = 0;
+	if (pid == -1)
+	{
+		child->pid = libkita_child_popen(child, KITA_SPAWN_FORK);
+		if (child->pid == -1)
+		{
+			child->pid = 0;
+			libkita_reap_child(state, child, W_EXITCODE(127, 0));
+			return;
+		}
+	}
+	else
+	{
+		int n = 0;
+		for (int i = 0; i < 3; ++i)
+		{
+			if (child->io[i])
+			{
+				child->io[i]->fd = fds[n++];
+			}
+		}
+		child->pid = pid;
+	}
+	libkita_child_started(child);
+}
+
+/*
+ * Creates all children that are still waiting for the zygote directly, as 
+ * the zygote has gone away; so will all children from now on.
+ */
+static void
+libkita_zygote_lost(kita_state_s *state)
+{
+	libkita_zygote_stop(state);
+
+	int fds[3] = { -1, -1, -1 };
+	while (state->num_spawning)
+	{
+		kita_child_s *child = state->spawning[0];
+		memmove(state->spawning, state->spawning + 1, 
+				--state->num_spawning * sizeof(kita_child_s*));
+		libkita_zygote_done(state, child, -1, fds);
+	}
+}
+
+/*
+ * Handles all replies of the zygote that came in, in the order the requests
+ * were sent, so each of them belongs to the child first in the queue.
+ */
+static void
+libkita_zygote_handle(kita_state_s *state)
+{
+	pid_t pid;
+	int   fds[3];
+	int   got;
+	while ((got = libkita_zygote_recv(state, &pid, fds)) == 1)
+	{
+		kita_child_s *child = NULL;
+		if (state->num_spawning)
+		{
+			child = state->spawning[0];
+			memmove(state->spawning, state->spawning + 1, 
+					--state->num_spawning * sizeof(kita_child_s*));
+		}
+		libkita_zygote_done(state, child, pid, fds);
+	}
+
+	if (got == -1)
+	{
+		libkita_zygote_lost(state);
+	}
+
+	// without pidfds, the child might have exited before we knew its PID,
+	// in which case we have missed its SIGCHLD, so check on it right away
+	if (state->sigfd != -1)
+	{
+		libkita_reap(state);
+	}
+}
+
+/*
+ * Returns the watch for the given file descriptor, or NULL if it isn't watched.
+ */
+static kita_watch_s*
+libkita_watch_get(kita_state_s *state, int fd)
+{
+	for (size_t i = 0; i < state->num_watches; ++i)
+	{
+		if (state->watches[i].fd == fd)
+		{
+			return &state->watches[i];
+		}
+	}
+	return NULL;
+}
+
 static int
 libkita_handle_event(kita_state_s *state, struct epoll_event *epev)
 {
-	kita_child_s *child = libkita_child_get_by_fd(state, epev->data.fd);
+	int      fd  = (int) (uint32_t) epev->data.u64;
+	uint32_t tag = (uint32_t) (epev->data.u64 >> 32);
+
+	// timerfd expired: read the expiration count, then tell the user
+	if (fd == state->tfd)
+	{
+		uint64_t expirations = 0;
+		if (read(state->tfd, &expirations, sizeof(expirations)) > 0)
+		{
+			++state->stats.timers;
+			kita_event_s event = { .type = KITA_EVT_TIMER, .ios = KITA_IOS_NONE, .fd = -1 };
+			libkita_dispatch_event(state, &event);
+		}
+		return 0;
+	}
+
+	// the zygote has replied to spawn requests, or has gone away
+	if (fd == state->zygote)
+	{
+		libkita_zygote_handle(state);
+		return 0;
+	}
+
+	// SIGCHLD via signalfd (no pidfd support): reap all dead children
+	if (fd == state->sigfd)
+	{
+		libkita_sigfd_drain(state);
+		libkita_reap(state);
+		return 0;
+	}
+
+	// one of the user's file descriptors: it's up to the user to read it
+	kita_watch_s *watch = libkita_watch_get(state, fd);
+	if (watch)
+	{
+		if (watch->tag != tag)
+		{
+			return 0; // stale, see below
+		}
+		kita_event_s event = { .type = KITA_EVT_FD_READOK, .ios = KITA_IOS_NONE,
+			.fd = watch->fd, .size = -1, .ctx = watch->ctx };
+		libkita_dispatch_event(state, &event);
+		return 0;
+	}
+
+	kita_child_s *child = libkita_child_get_by_fd(state, fd);
 	if (child == NULL)
 	{
 		return 0;
 	}
 
+	// pidfd became readable: this exact child has exited
+	if (fd == child->pidfd)
+	{
+		if (child->pidfd_tag == tag)
+		{
+			libkita_reap_pidfd(state, child);
+		}
+		return 0;
+	}
+
+	// an event from earlier in this batch might have closed the fd, and the 
+	// callbacks might have opened a new one with the same number since; then
+	// the event is for the old fd and the tag won't match that of the new one
 	kita_event_s event = { 0 };
 	event.child = child;
-	event.fd    = epev->data.fd; 
-	event.ios   = libkita_child_fd_get_type(child, epev->data.fd);
+	event.fd    = fd; 
+	event.ios   = libkita_child_fd_get_type(child, fd);
+	if (event.ios == (kita_ios_type_e) -1 || child->io[event.ios]->tag != tag)
+	{
+		return 0;
+	}
 
 	// EPOLLIN: We've got data coming in
 	if(epev->events & EPOLLIN)
 	{
-		event.type = KITA_EVT_CHILD_READOK; 
-		event.size = libkita_fd_data_avail(event.fd);
+		event.type = KITA_EVT_CHILD_READOK;
+		event.size = -1; // the reader drains the pipe until EAGAIN anyway
 		libkita_dispatch_event(state, &event);
 		return 0;
 	}
 	
-	// EPOLLOUT: We're ready to send data
-	if (epev->events & EPOLLOUT)
+	// EPOLLOUT: We're ready to send data (EPOLLERR: reader has gone away)
+	if (epev->events & EPOLLOUT && !(epev->events & EPOLLERR))
 	{
-		event.type = KITA_EVT_CHILD_FEEDOK;
-		libkita_dispatch_event(state, &event);
+		// write pending input first, user code only gets to feed more
+		// once everything that was queued before has been written
+		if (libkita_stream_flush(state, child->io[event.ios]) == 0)
+		{
+			event.type = KITA_EVT_CHILD_FEEDOK;
+			libkita_dispatch_event(state, &event);
+		}
 		return 0;
 	}
 	
@@ -960,13 +2616,22 @@ libkita_handle_event(kita_state_s *state, struct epoll_event *epev)
 	// EPOLLHUP:   Unexpected hangup on socket 
 	if (epev->events & EPOLLRDHUP || epev->events & EPOLLHUP)
 	{
+		// hand out what's left in the pipe or buffer before closing
+		if (event.ios != KITA_IOS_IN && libkita_stream_pending(child->io[event.ios]))
+		{
+			kita_event_s event_read = event;
+			event_read.type = KITA_EVT_CHILD_READOK;
+			event_read.size = -1;
+			libkita_dispatch_event(state, &event_read);
+		}
+
 		// dispatch hangup event
 		event.type = KITA_EVT_CHILD_HANGUP;
 		libkita_dispatch_event(state, &event);
 
 		// close the stream
 		libkita_stream_rem_ev(state, child->io[event.ios]);
-		libkita_stream_close(child->io[event.ios]);
+		libkita_stream_close(state, child->io[event.ios]);
 
 		// create closed event by making a copy of the original
 		kita_event_s event_closed = event;
@@ -988,7 +2653,7 @@ libkita_handle_event(kita_state_s *state, struct epoll_event *epev)
 		if (event.ios == KITA_IOS_IN || errno == EBADF) 
 		{
 			libkita_stream_rem_ev(state, child->io[event.ios]);
-			libkita_stream_close(child->io[event.ios]);
+			libkita_stream_close(state, child->io[event.ios]);
 
 			// dispatch closed event
 			event.type = KITA_EVT_CHILD_CLOSED;
@@ -1003,110 +2668,225 @@ libkita_handle_event(kita_state_s *state, struct epoll_event *epev)
 
 
 /*
- * Closes the given stream, then frees its memory and sets it to NULL. 
+ * Closes the given stream, then frees its memory and sets it to NULL.
  */
 void
 libkita_stream_free(kita_stream_s** stream)
 {
-	if ((*stream)->fp)
-	{
-		libkita_stream_close(*stream);
-	}
+	libkita_stream_close(NULL, *stream);
 
+	free((*stream)->buf);
 	free(*stream);
 	*stream = NULL;
 }
 
 /*
- * TODO - currently we only ever get the last line, regardles of `last`
- *      - error handling for getline() (EOF, error) 
+ * Makes sure the stream has its read buffer. Returns 0 on success, -1 if
+ * the buffer could not be allocated. This only allocates once per stream.
  */
-static char*
-libkita_stream_read_line(kita_stream_s *stream, int last, int no_nl)
+static int
+libkita_stream_buffer(kita_stream_s *stream)
+{
+	if (stream->buf == NULL)
+	{
+		stream->buf = malloc(KITA_BUFFER_SIZE);
+	}
+	return stream->buf ? 0 : -1;
+}
+
+/*
+ * Looks at the part of the stream's buffer that has not yet been handed out
+ * and, if it contains at least one complete line, moves the last of those
+ * lines to the front of the buffer, followed by a newline and a terminating
+ * null byte, followed by whatever (incomplete line) came after it. Lines that
+ * came before it are dropped. Returns 1 if a new line is now held, else 0.
+ */
+static int
+libkita_stream_hold_line(kita_stream_s *stream)
+{
+	char  *from = stream->buf + stream->hold;
+	size_t size = stream->len - stream->hold;
+
+	char *nl = memrchr(from, '\n', size);
+	if (nl == NULL)
+	{
+		return 0;
+	}
+
+	// find the start of the last complete line
+	char *prev  = memrchr(from, '\n', nl - from);
+	char *start = prev ? prev + 1 : from;
+
+	// the first "line" might be the tail of an overlong line, drop it
+	if (stream->skip && prev == NULL)
+	{
+		stream->skip = 0;
+		size_t rest = (stream->buf + stream->len) - (nl + 1);
+		memmove(from, nl + 1, rest);
+		stream->len = stream->hold + rest;
+		return libkita_stream_hold_line(stream);
+	}
+	stream->skip = 0;
+
+	// move the line to the front, then what came after it, behind that;
+	// this needs at most one byte more than is in use, which the caller
+	// has to have reserved, see libkita_stream_read_line()
+	size_t line = nl - start;
+	size_t rest = (stream->buf + stream->len) - (nl + 1);
+	memmove(stream->buf, start, line);
+	memmove(stream->buf + line + 2, nl + 1, rest);
+	stream->buf[line]     = '\n';
+	stream->buf[line + 1] = '\0';
+
+	stream->hold = line + 2;
+	stream->len  = stream->hold + rest;
+	return 1;
+}
+
+/*
+ * Reads from the stream's file descriptor via read() until it would block
+ * (EAGAIN), as required for edge-triggered epoll, or until end of file.
+ * Incomplete lines are kept in the stream's buffer and completed by the next
+ * read. Lines that don't fit the buffer (KITA_BUFFER_SIZE) are discarded.
+ * At end of file, an incomplete last line counts as complete. Returns a
+ * pointer to the last complete line (null terminated, with or without the
+ * newline, depending on `no_nl`) that is valid until the next read from this
+ * stream, or NULL if no complete line was read; lines before the last one 
+ * are dropped. No memory is allocated, apart from the stream's buffer on the
+ * very first read.
+ */
+static const char*
+libkita_stream_read_line(kita_stream_s *stream, int no_nl)
 {
-	if (stream->fp == NULL)
+	if (stream->fd == -1 || libkita_stream_buffer(stream) == -1)
 	{
 		return NULL;
 	}
 
-	// TODO I thought getline() would be the perfect tool here, as it even 
-	//      allocates a suitable buffer by itself. however, for whatever 
-	//      reason, getline() returns -1 with EAGAIN _after_ the first line 
-	//      (for the second, third, ... line) - why does it fail to read?! 
-	//      data keeps building up...
-	/*
-	  [...] getline() approach here
-	*/
-
-	// TODO there is a bug in here. imagine this scenario: despite being
-	//      line buffered, the file descriptor has _multiple_ lines ready 
-	//      to be read (yes, this does happen). in this case, while we do 
-	//      seem to get the correct amount of data waiting, we fail to 
-	//      read all of it, because fgets() stops at a newline - and there 
-	//      are now two (or more) newlines in the data to be read.
-	/*
-	size_t len = libkita_fd_data_avail(stream->fd) + 1;
-	char*  buf = malloc(len * sizeof(char));
-
-	fgets(buf, len, stream->fp);
-	*/
-
-	size_t num_lines = 0;
-	size_t len = libkita_fd_data_avail(stream->fd) + 2;
-	char*  buf = malloc(len * sizeof(char));
-	
-	// fgets() - reads until a newline ('\n') or EOF (end of file)
-	//         - returns NULL on error or when EOF occurs
-	while (fgets(buf, len, stream->fp) != NULL)
+	// drop the line handed out last time, keep the incomplete rest
+	if (stream->hold)
+	{
+		memmove(stream->buf, stream->buf + stream->hold, stream->len - stream->hold);
+		stream->len -= stream->hold;
+		stream->hold = 0;
+	}
+
+	int got_line = 0;
+	for (;;)
+	{
+		// buffer full, but no newline in sight: overlong line
+		if (stream->len >= KITA_BUFFER_SIZE - 2 && stream->len > stream->hold)
+		{
+			stream->len  = stream->hold;
+			stream->skip = 1;
+		}
+
+		// the line we hold fills the buffer by itself, it's too long as well
+		if (stream->len >= KITA_BUFFER_SIZE - 2)
+		{
+			stream->len  = 0;
+			stream->hold = 0;
+			got_line = 0;
+		}
+
+		// we keep two bytes in reserve: one for the newline we might add
+		// at end of file, one for the null byte libkita_stream_hold_line()
+		// might add, so `len` never goes past the last byte of the buffer
+		size_t  room = KITA_BUFFER_SIZE - 2 - stream->len;
+		ssize_t n    = read(stream->fd, stream->buf + stream->len, room);
+
+		if (n > 0)
+		{
+			stream->len += n;
+			got_line |= libkita_stream_hold_line(stream);
+			continue;
+		}
+
+		if (n == -1 && errno == EINTR)
+		{
+			continue;
+		}
+
+		// end of file: treat an incomplete last line as complete; the
+		// checks above leave room for the newline and the null byte
+		if (n == 0 && stream->len > stream->hold)
+		{
+			stream->buf[stream->len++] = '\n';
+			got_line |= libkita_stream_hold_line(stream);
+		}
+
+		// EAGAIN (drained), end of file or error
+		break;
+	}
+
+	if (!got_line)
 	{
-		++num_lines;
+		return NULL;
 	}
 
 	// remove trailing newline, if requested
 	if (no_nl)
 	{
-		buf[strcspn(buf, "\n")] = 0;
+		stream->buf[stream->hold - 2] = '\0';
 	}
-
-	// return the last line we read
-	return buf;
+	return stream->buf;
 }
 
 /*
- * TODO - what if libkita_fd_data_avail() comes back as -1 (can't determine)?
- *      - what if fread() encounters EOF (feof()) or an error (ferror())?
+ * Reads all data from the stream's file descriptor via read(), until it would
+ * block (EAGAIN) or until end of file. If there is more data than fits into
+ * the stream's buffer, only the most recent chunk of data is kept.
+ * Returns a pointer to the null terminated data, valid until the next read
+ * from this stream, or NULL if no data was read.
  */
-static char*
+static const char*
 libkita_stream_read_data(kita_stream_s *stream)
 {
-	if (stream->fd < 2)
+	if (stream->fd == -1 || libkita_stream_buffer(stream) == -1)
 	{
 		return NULL;
 	}
-	if (stream->fp == NULL)
+
+	stream->len  = 0;
+	stream->hold = 0;
+
+	for (;;)
 	{
-		return NULL;
+		size_t  room = KITA_BUFFER_SIZE - 1 - stream->len;
+		ssize_t n    = read(stream->fd, stream->buf + stream->len, room);
+
+		if (n > 0)
+		{
+			stream->len += n;
+			if (stream->len == KITA_BUFFER_SIZE - 1)
+			{
+				stream->len = 0; // keep the most recent data only
+			}
+			continue;
+		}
+		if (n == -1 && errno == EINTR)
+		{
+			continue;
+		}
+		break;
 	}
 
-	// TODO I believe there to be a bug here (race condition), where there
-	//      could be new data already arriving between the calls to 
-	//      libkita_fd_data_avail() and fgets(), effectively making us 
-	//      not read all the data that is available, which then gets us 
-	//      into some unholy stuck mess!
-	size_t len = libkita_fd_data_avail(stream->fd) + 2;
-	char*  buf = malloc(len * sizeof(char));
+	if (stream->len == 0)
+	{
+		return NULL;
+	}
 
-	fread(buf, len, 1, stream->fp);
-	return buf;
+	stream->buf[stream->len] = '\0';
+	stream->len = 0;
+	return stream->buf;
 }
 
-// TODO implement (properly)
-static char*
-libkita_stream_read(kita_stream_s *stream, int last, int no_nl)
+static const char*
+libkita_stream_read(kita_stream_s *stream, int no_nl)
 {
 	if (stream->buf_type == KITA_BUF_LINE)
 	{
-		return libkita_stream_read_line(stream, last, no_nl);
+		return libkita_stream_read_line(stream, no_nl);
 	}
 
 	else
@@ -1115,11 +2895,14 @@ libkita_stream_read(kita_stream_s *stream, int last, int no_nl)
 	}
 }
 
+/*
+ * Waits for events via epoll_pwait(), for up to `timeout` milliseconds, then
+ * handles all events that became available, up to the size of the state's
+ * event array. Returns the number of events handled or -1 on error.
+ */
 int
 libkita_poll(kita_state_s *s, int timeout)
 {
-	struct epoll_event epev;
-	
 	// epoll_wait()/epoll_pwait() will return -1 if a signal is caught.
 	// User code might catch "harmless" signals, like SIGWINCH, that are
 	// ignored by default. This would then cause epoll_wait() to return
@@ -1139,7 +2922,7 @@ libkita_poll(kita_state_s *s, int timeout)
 
 	// timeout = -1 -> block indefinitely, until events available
 	// timeout =  0 -> return immediately, even if no events available
-	int num_events = epoll_pwait(s->epfd, &epev, 1, timeout, &sigset);
+	int num_events = epoll_pwait(s->epfd, s->events, s->max_events, timeout, &sigset);
 
 	// An error has occured
 	if (num_events == -1)
@@ -1164,8 +2947,11 @@ libkita_poll(kita_state_s *s, int timeout)
 		return -1;
 	}
 
-	libkita_handle_event(s, &epev); // TODO what to do with the return val?
-	return 0;
+	for (int i = 0; i < num_events; ++i)
+	{
+		libkita_handle_event(s, &s->events[i]); // TODO what to do with the return val?
+	}
+	return num_events;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1185,7 +2971,7 @@ kita_child_is_open(kita_child_s *child)
 	{
 		if (child->io[i])
 		{
-			open += child->io[i]->fp != NULL;
+			open += child->io[i]->fd != -1;
 		}
 	}
 	return open;
@@ -1249,11 +3035,20 @@ kita_child_skip(kita_child_s *child, kita_ios_type_e ios)
 	{
 		return -1;
 	}
-	if (child->io[ios]->fp == NULL) // stream closed
+	if (child->io[ios]->fd == -1)   // stream closed
 	{
 		return -1;
 	}
-	return fseek(child->io[ios]->fp, 0, SEEK_END);
+
+	// discard everything that is buffered or waiting in the pipe
+	char buf[KITA_BUFFER_SIZE];
+	while (read(child->io[ios]->fd, buf, sizeof(buf)) > 0)
+	{
+		// nothing to do
+	}
+	child->io[ios]->len  = 0;
+	child->io[ios]->hold = 0;
+	return 0;
 }
 
 /*
@@ -1323,6 +3118,43 @@ kita_child_get_arg(kita_child_s *child)
 	return child->arg;
 }
 
+/*
+ * If `group` is set, the child will be run in a process group of its own,
+ * so that kita_child_term() and kita_child_kill() reach all of its children,
+ * too. Note that the child won't get signals meant for our process group, 
+ * like SIGINT from the terminal, anymore. Takes effect on the next open.
+ */
+void
+kita_child_set_group(kita_child_s *child, int group)
+{
+	child->group = group;
+}
+
+/*
+ * Sets the nice value, scheduling policy, I/O priority and CPU affinity the
+ * child will be run with, as far as they are marked as set in `prio`; the 
+ * others are inherited from us, as usual. Use NULL to clear all of them.
+ * Children with any of these set will not be created via posix_spawn(), but
+ * via vfork() instead. Takes effect on the next open.
+ */
+void
+kita_child_set_prio(kita_child_s *child, const kita_prio_s *prio)
+{
+	child->prio = prio ? *prio : (kita_prio_s) { 0 };
+}
+
+/*
+ * Sets the size of the pipe for the child's stdout, in bytes, which the
+ * kernel will round up to a power of two number of pages (and cap at the
+ * limit in /proc/sys/fs/pipe-max-size for unprivileged users). Use 0 for
+ * the default size. Takes effect on the next open.
+ */
+void
+kita_child_set_pipe_size(kita_child_s *child, int size)
+{
+	child->pipe_size = size;
+}
+
 void
 kita_child_set_context(kita_child_s *child, void *ctx)
 {
@@ -1368,28 +3200,22 @@ kita_child_open(kita_child_s *child)
 	{
 		return open;
 	}
-	
-	// make stdout and stderr streams non-blocking
-	if (child->io[KITA_IOS_OUT])
-	{
-		libkita_stream_set_blocking(child->io[KITA_IOS_OUT], 0);
-	}
-	if (child->io[KITA_IOS_ERR])
-	{
-		libkita_stream_set_blocking(child->io[KITA_IOS_ERR], 0);
-	}
 
-	// if child is tracked, register events for it
-	if (child->state)
+	// handed to the zygote, we'll finish up once it has created the child
+	if (open == 1)
 	{
-		libkita_child_reg_events(child->state, child);
+		return 0;
 	}
+
+	libkita_child_started(child);
 	return 0;
 }
 
 /*
  * Sends the SIGKILL signal to the child. SIGKILL can not be ignored 
  * and leads to immediate shut-down of the child process, no clean-up.
+ * If the child runs in a process group of its own, the signal will be sent
+ * to the whole group, so that the child's own children get it as well.
  * Returns 0 on success, -1 on error.
  */
 int
@@ -1403,12 +3229,14 @@ kita_child_kill(kita_child_s *child)
 	// We do not set the child's PID to 0 here, because it seems
 	// like the better approach to detect all child deaths via 
 	// waitpid() or some other means (same approach for all).
-	return kill(child->pid, SIGKILL);
+	return kill(child->group ? -child->pid : child->pid, SIGKILL);
 }
 
 /*
  * Sends the SIGTERM signal to the child. SIGTERM can be ignored or 
  * handled and allows the child to do clean-up before shutting down.
+ * If the child runs in a process group of its own, the signal will be sent
+ * to the whole group, so that the child's own children get it as well.
  * Returns 0 on success, -1 on error.
  */
 int
@@ -1423,21 +3251,21 @@ kita_child_term(kita_child_s *child)
 	// child might not immediately terminate (clean-up, etc). 
 	// Instead, we should catch SIGCHLD, then use waitpid()
 	// to determine the termination and to set PID to 0.
-	return kill(child->pid, SIGTERM);
+	return kill(child->group ? -child->pid : child->pid, SIGTERM);
 }
 
 /*
  * Attempts to read from the child's stream specified by `ios` (should be one 
- * of KITA_IOS_OUT, KITA_IOS_ERR) and returns the read bytes as a dynamically
- * allocated string (caller needs to free it at some point). All available data 
- * will be read. For line buffered streams, this means that all lines will be 
- * read, if multiple are available. If the child is tracked by the state and 
- * the LAST_LINE option is enabled, all but the last line will be discarded. 
- * If the NO_NEWLINE option is enabled in addition to LAST_LINE, the line feed 
- * (new line) character '\n' will be removed from the returned buffer.
- * Returns NULL on error or if there was no data available for reading.
+ * of KITA_IOS_OUT, KITA_IOS_ERR) and returns the read bytes as a string that 
+ * is owned by the stream and stays valid until the next read from it; copy it 
+ * if you need to keep it around. All available data will be read. For line 
+ * buffered streams, this means that all lines will be read, if multiple are 
+ * available, and the last complete line will be returned; an incomplete line 
+ * is kept and completed by subsequent reads. If the NO_NEWLINE option is 
+ * enabled, the line feed (new line) character '\n' will be removed from the 
+ * returned line. Returns NULL on error or if no (complete) data was available.
  */
-char*
+const char*
 kita_child_read(kita_child_s *child, kita_ios_type_e ios)
 {
 	if (ios != KITA_IOS_OUT && ios != KITA_IOS_ERR)
@@ -1450,27 +3278,20 @@ kita_child_read(kita_child_s *child, kita_ios_type_e ios)
 		return NULL;
 	}
 
-	// TODO - would it be nicer if we just allocated a buffer internally?
-	//      - maybe use getline() instead? It allocates a suitable buffer!
-	//      - maybe we can put this to use: libkita_fd_data_avail(int fd)
-	//      - implement differently depending on the child's buffer type?
-	//      - fgets() vs getline() vs read() vs fread() vs ... !?
-	// https://stackoverflow.com/questions/6220093/
-	// https://stackoverflow.com/questions/2751632/
-	// https://stackoverflow.com/questions/584142/
-	// -- I think we should use fread() for fully or unbuffered streams,
-	//    and fgets() or getline() for line buffered streams
-
 	kita_state_s* state = child->state;
-	int last = state ? kita_get_option(state, KITA_OPT_LAST_LINE) : 0;
 	int nonl = state ? kita_get_option(state, KITA_OPT_NO_NEWLINE) : 0;
 
-	return libkita_stream_read(child->io[ios], last, nonl);
+	return libkita_stream_read(child->io[ios], nonl);
 }
 
 /*
- * Writes the given `input` to the child's stdin stream.
- * Returns 0 on success, -1 on error.
+ * Writes the given `input` to the child's stdin stream, without blocking.
+ * If the child isn't reading fast enough, the input (or what's left of it)
+ * will be queued and written once the child is ready for more, just before
+ * the FEEDOK event is dispatched. Input that has been partially written will
+ * always be completed, but input that hasn't been started on yet will be
+ * replaced by newer input: only the most recent input is kept in the queue.
+ * Returns 0 if the input has been written or queued, -1 on error.
  */
 int
 kita_child_feed(kita_child_s *child, const char *input)
@@ -1481,8 +3302,8 @@ kita_child_feed(kita_child_s *child, const char *input)
 		return -1;
 	}
 	
-	// child's stdin file pointer isn't open
-	if (child->io[KITA_IOS_IN]->fp == NULL) 
+	// child's stdin file descriptor isn't open (yet)
+	if (child->io[KITA_IOS_IN]->fd == -1 && !child->spawning)
 	{
 		return -1;
 	}
@@ -1493,15 +3314,73 @@ kita_child_feed(kita_child_s *child, const char *input)
 		return -1;
 	}
 
-	return (fputs(input, child->io[KITA_IOS_IN]->fp) == EOF) ? -1 : 0;
+	kita_state_s  *state  = child->state;
+	kita_stream_s *stream = child->io[KITA_IOS_IN];
+
+	if (state)
+	{
+		++state->stats.feeds;
+	}
+
+	// the zygote is still creating the child, queue it until it has
+	if (child->spawning)
+	{
+		if (stream->next && state)
+		{
+			++state->stats.superseded;
+		}
+		free(stream->next);
+		stream->next = strdup(input);
+		return stream->next ? 0 : -1;
+	}
+
+	// still busy with previous input, replace whatever hasn't been started on
+	int queued = libkita_stream_flush(state, stream);
+	if (queued == -1)
+	{
+		return -1;
+	}
+	if (queued == 1)
+	{
+		if (stream->next && state)
+		{
+			++state->stats.superseded;
+		}
+		free(stream->next);
+		stream->next = strdup(input);
+		return stream->next ? 0 : -1;
+	}
+
+	// queue is empty, try to write directly, only queue what's left over
+	size_t  len = strlen(input);
+	ssize_t n   = libkita_stream_write(stream, input, len);
+	if (n == -1)
+	{
+		if (state)
+		{
+			++state->stats.dropped;
+		}
+		return -1;
+	}
+	if ((size_t) n < len)
+	{
+		stream->out = strdup(input + n);
+		if (stream->out == NULL)
+		{
+			return -1;
+		}
+		stream->out_len = len - n;
+		stream->out_off = 0;
+	}
+	return 0;
 }
 
 void
 kita_child_free(kita_child_s** child)
 {
-	// this is necessary because kita_child_del() will change the address 
-	// of the pointer, hence we can't dereference `child` after the call,
-	// but a copy of it (here: `c`) will have a different address, solved
+	// this is necessary because kita_child_del() will clear the registry 
+	// slot that `child` might point to, hence we can't dereference `child`
+	// after the call, but a copy of it (here: `c`) will be unaffected
 	kita_child_s* c = *child;
 
 	// unregister events and delete from state
@@ -1513,8 +3392,15 @@ kita_child_free(kita_child_s** child)
 	// send SIGKILL if child is still running
 	//kita_child_kill(c);
 
-	// free the child's cmd string
+	// free the child's cmd string and what we've derived from it
 	free(c->cmd);
+	for (size_t i = 0; c->argv && i < c->argc; ++i)
+	{
+		free(c->argv[i]);
+	}
+	free(c->argv);
+	free(c->exe);
+	free(c->exe_env);
 
 	// free the streams (this also closes them)
 	for (int i = 0; i < 3; ++i)
@@ -1545,9 +3431,11 @@ kita_child_new(const char *cmd, int in, int out, int err)
 
 	// zero-initialize
 	*child = (kita_child_s) { 0 };
+	child->pidfd = -1;
 
-	// copy the command
-	child->cmd = strdup(cmd);
+	// copy the command and split it into arguments, once
+	child->cmd  = strdup(cmd);
+	child->argv = libkita_split_cmd(cmd, &child->argc);
 
 	// create input/output streams as requested
 	child->io[KITA_IOS_IN]  = in ? 	libkita_stream_new(KITA_IOS_IN)  : NULL;
@@ -1570,7 +3458,8 @@ kita_child_add(kita_state_s *state, kita_child_s *child)
 		// TODO set/return error code
 		return -1;
 	}
-	return state->num_children < libkita_child_add(state, child) ? 0 : -1;
+	size_t num_children = state->num_children;
+	return libkita_child_add(state, child) > num_children ? 0 : -1;
 }
 
 /*
@@ -1590,9 +3479,17 @@ kita_child_del(kita_state_s *state, kita_child_s *child)
 	
 	// remove child from epoll
 	libkita_child_rem_events(state, child);
+	libkita_pidfd_close(state, child);
+
+	// the zygote might still be creating it, it will be killed once it has
+	if (child->spawning)
+	{
+		libkita_zygote_cancel(state, child);
+	}
 
 	// remove child from state
-	return state->num_children > libkita_child_del(state, child) ? 0 : -1;
+	size_t num_children = state->num_children;
+	return libkita_child_del(state, child) < num_children ? 0 : -1;
 }
 
 /*
@@ -1638,14 +3535,173 @@ kita_set_callback(kita_state_s *state, kita_evt_type_e type, kita_call_c cb)
 	return 0;
 }
 
+/*
+ * Sets the method used to create child processes, one of KITA_SPAWN_FORK
+ * (the default), KITA_SPAWN_VFORK, KITA_SPAWN_CLONE, KITA_SPAWN_POSIX or
+ * KITA_SPAWN_ZYGOTE. All but the first avoid copying our page tables for 
+ * every child, which makes them considerably faster. KITA_SPAWN_ZYGOTE 
+ * immediately starts a helper process (the zygote) that will create all 
+ * children from then on, while kita_tick() goes on handling events; their 
+ * PIDs and pipes are only known once the zygote has replied, input fed to
+ * them until then is queued. If the zygote goes away, fork() will be used.
+ * Returns 0 on success, -1 on error.
+ */
+int
+kita_set_spawn(kita_state_s *state, kita_spawn_type_e type)
+{
+	if (type < 0 || type >= KITA_SPAWN_COUNT)
+	{
+		return -1;
+	}
+
+	if (type == KITA_SPAWN_ZYGOTE && libkita_zygote_start(state) == -1)
+	{
+		return -1;
+	}
+	if (type != KITA_SPAWN_ZYGOTE)
+	{
+		libkita_zygote_lost(state);
+	}
+
+	state->spawn = type;
+	return 0;
+}
+
+/*
+ * Sets the maximum number of events that will be handled per call to 
+ * kita_tick(). Returns 0 on success, -1 on error (old size is kept).
+ */
+int
+kita_set_max_events(kita_state_s *state, int max)
+{
+	if (max < 1)
+	{
+		return -1;
+	}
+
+	struct epoll_event *events = realloc(state->events, max * sizeof(struct epoll_event));
+	if (events == NULL)
+	{
+		return -1;
+	}
+
+	state->events     = events;
+	state->max_events = max;
+	return 0;
+}
+
+/*
+ * Arms the state's timer to expire at the given absolute time, measured 
+ * against CLOCK_MONOTONIC. Once it expires, the TIMER event is dispatched 
+ * from within kita_tick(). Use NULL to disarm the timer. Times in the past 
+ * make the timer expire right away. Returns 0 on success, -1 on error.
+ */
+int
+kita_set_timer(kita_state_s *state, const struct timespec *ts)
+{
+	if (state->tfd == -1)
+	{
+		return -1;
+	}
+
+	// all zero disarms the timer
+	struct itimerspec its = { 0 };
+	if (ts)
+	{
+		its.it_value = *ts;
+
+		// an it_value of zero would disarm, so expire a tiny bit later
+		if (ts->tv_sec == 0 && ts->tv_nsec == 0)
+		{
+			its.it_value.tv_nsec = 1;
+		}
+	}
+	return timerfd_settime(state->tfd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+/*
+ * Has the state watch the given file descriptor, which it won't read from, 
+ * nor close: whenever it becomes readable, the FD_READOK event is dispatched
+ * from within kita_tick(), with `ctx` as the event's context. The descriptor
+ * is watched level-triggered, so the user should read all there is to read.
+ * Returns 0 on success, -1 on error.
+ */
+int
+kita_watch_fd(kita_state_s *state, int fd, void *ctx)
+{
+	if (fd < 0 || libkita_watch_get(state, fd))
+	{
+		return -1;
+	}
+
+	kita_watch_s *watches = realloc(state->watches, 
+			(state->num_watches + 1) * sizeof(kita_watch_s));
+	if (watches == NULL)
+	{
+		return -1;
+	}
+	state->watches = watches;
+
+	uint32_t tag;
+	struct epoll_event epev = { .events = EPOLLIN, .data.u64 = libkita_tag(state, fd, &tag) };
+	if (epoll_ctl(state->epfd, EPOLL_CTL_ADD, fd, &epev) == -1)
+	{
+		return -1;
+	}
+
+	state->watches[state->num_watches++] = (kita_watch_s) { .fd = fd, .ctx = ctx, .tag = tag };
+	return 0;
+}
+
+/*
+ * Stops watching the given file descriptor, see kita_watch_fd(). This has to 
+ * be done before the descriptor is closed. Returns 0 on success, -1 if the 
+ * descriptor wasn't watched.
+ */
+int
+kita_unwatch_fd(kita_state_s *state, int fd)
+{
+	kita_watch_s *watch = libkita_watch_get(state, fd);
+	if (watch == NULL)
+	{
+		return -1;
+	}
+
+	epoll_ctl(state->epfd, EPOLL_CTL_DEL, fd, NULL);
+	*watch = state->watches[--state->num_watches];
+	return 0;
+}
+
+/*
+ * Returns a pointer to the state's event counters.
+ */
+const kita_stats_s*
+kita_get_stats(kita_state_s *state)
+{
+	return &state->stats;
+}
+
 int
 kita_tick(kita_state_s *state, int timeout)
 {
-	// wait for child events via epoll_pwait()
-	libkita_poll(state, timeout);
+	// wait for child events via epoll_pwait(), handle all that are ready
+	int num_events = libkita_poll(state, timeout);
+
+	// update the counters
+	state->stats.ticks      += 1;
+	state->stats.last_batch  = num_events > 0 ? num_events : 0;
+	state->stats.events     += state->stats.last_batch;
+	if (state->stats.last_batch > state->stats.max_batch)
+	{
+		state->stats.max_batch = state->stats.last_batch;
+	}
 	
-	// reap dead children via waitpid()
-	libkita_reap(state);
+	// children are reaped as their pidfd or the SIGCHLD signalfd fires;
+	// only if we failed to get a pidfd for some, we need to sweep for them
+	if (state->num_unwatched)
+	{
+		libkita_reap(state);
+	}
 
 	// remove children that terminated without us noticing
 	if (state->options[KITA_OPT_AUTOCLEAN])
@@ -1679,6 +3735,18 @@ kita_loop(kita_state_s* state)
 	return 0; // TODO
 }
 
+/*
+ * Applies the given priority settings to the calling process, for example 
+ * before creating any children, which will then inherit them. Settings that
+ * can't be applied are skipped. Returns 0 if all of them have been applied,
+ * -1 otherwise.
+ */
+int
+kita_apply_prio(const kita_prio_s *prio)
+{
+	return libkita_apply_prio(prio);
+}
+
 /*
  * Sends a SIGKILL signal to all children, if any, known by the state.
  */
@@ -1686,9 +3754,12 @@ void
 kita_kill(kita_state_s* state)
 {
 	// terminate all children
-	for (size_t i = 0; i < state->num_children; ++i)
+	for (size_t i = 0; i < state->cap_children; ++i)
 	{
-		kita_child_kill(state->children[i]);
+		if (state->children[i])
+		{
+			kita_child_kill(state->children[i]);
+		}
 	}
 }
 
@@ -1699,11 +3770,31 @@ kita_kill(kita_state_s* state)
 void
 kita_free(kita_state_s** state)
 {
-	for (size_t i = 0; i < (*state)->num_children; ++i)
+	for (size_t i = 0; i < (*state)->cap_children; ++i)
 	{
-		kita_child_free(&(*state)->children[i]);
+		if ((*state)->children[i])
+		{
+			kita_child_free(&(*state)->children[i]);
+		}
 	}
 
+	free((*state)->children);
+	free((*state)->free_slots);
+	free((*state)->fds);
+	free((*state)->pids);
+	free((*state)->events);
+	free((*state)->watches);
+	free((*state)->spawning);
+	if ((*state)->sigfd != -1)
+	{
+		close((*state)->sigfd);
+	}
+	if ((*state)->tfd != -1)
+	{
+		close((*state)->tfd);
+	}
+	libkita_zygote_stop(*state);
+	close((*state)->epfd);
 	free(*state);
 	*state = NULL;
 }
@@ -1720,10 +3811,30 @@ kita_init()
 	
 	// Set the memory to a zero-initialized struct
 	*s = (kita_state_s) { 0 };
+	s->zygote = -1;
+
+	s->sigfd  = -1;
+	s->tfd    = -1;
 
 	// Initialize an epoll instance
 	if (libkita_init_epoll(s) != 0)
 	{
+		free(s);
+		return NULL;
+	}
+
+	// Create the timer, if this fails, users can still use timeouts
+	if (libkita_init_timer(s) != 0 && s->tfd != -1)
+	{
+		close(s->tfd);
+		s->tfd = -1;
+	}
+
+	// Figure out how we will be notified of child deaths, then allocate
+	// the array that epoll_pwait() will report events in
+	if (libkita_init_reaping(s) != 0 || kita_set_max_events(s, KITA_MAX_EVENTS) != 0)
+	{
+		kita_free(&s);
 		return NULL;
 	}
 
@@ -104,6 +104,71 @@ int lemon_ini_handler(void *data, const char *section, const char *name, const c
 		cfg_set_str(lc, LEMON_OPT_AFFIX_FONT, is_quoted(value) ? unquote(value) : strdup(value));
 		return 1;
 	}
+	if (equals(name, "timer-slack"))
+	{
+		cfg_set_int(lc, LEMON_OPT_TIMER_SLACK, atoi(value));
+		return 1;
+	}
+	if (equals(name, "max-events"))
+	{
+		cfg_set_int(lc, LEMON_OPT_MAX_EVENTS, atoi(value));
+		return 1;
+	}
+	if (equals(name, "frame-interval"))
+	{
+		cfg_set_int(lc, LEMON_OPT_FRAME_INTERVAL, atoi(value));
+		return 1;
+	}
+	if (equals(name, "frame-coalesce"))
+	{
+		cfg_set_int(lc, LEMON_OPT_FRAME_COALESCE, atoi(value));
+		return 1;
+	}
+	if (equals(name, "frame-latency"))
+	{
+		cfg_set_int(lc, LEMON_OPT_FRAME_LATENCY, atoi(value));
+		return 1;
+	}
+	if (equals(name, "spawn"))
+	{
+		cfg_set_str(lc, LEMON_OPT_SPAWN, is_quoted(value) ? unquote(value) : strdup(value));
+		return 1;
+	}
+	if (equals(name, "max-running"))
+	{
+		cfg_set_int(lc, LEMON_OPT_MAX_RUNNING, atoi(value));
+		return 1;
+	}
+	if (equals(name, "spawn-rate"))
+	{
+		cfg_set_float(lc, LEMON_OPT_SPAWN_RATE, atof(value));
+		return 1;
+	}
+	if (equals(name, "spawn-burst"))
+	{
+		cfg_set_int(lc, LEMON_OPT_SPAWN_BURST, atoi(value));
+		return 1;
+	}
+	if (equals(name, "nice"))
+	{
+		cfg_set_int(lc, LEMON_OPT_NICE, atoi(value));
+		return 1;
+	}
+	if (equals(name, "sched"))
+	{
+		cfg_set_str(lc, LEMON_OPT_SCHED, is_quoted(value) ? unquote(value) : strdup(value));
+		return 1;
+	}
+	if (equals(name, "ioprio"))
+	{
+		cfg_set_str(lc, LEMON_OPT_IOPRIO, is_quoted(value) ? unquote(value) : strdup(value));
+		return 1;
+	}
+	if (equals(name, "affinity"))
+	{
+		cfg_set_str(lc, LEMON_OPT_AFFINITY, is_quoted(value) ? unquote(value) : strdup(value));
+		return 1;
+	}
 
 	// Unknown section or name
 	return 0;
@@ -121,6 +186,16 @@ int block_ini_handler(void *data, const char *section, const char *name, const c
 		cfg_set_str(bc, BLOCK_OPT_BIN, is_quoted(value) ? unquote(value) : strdup(value));
 		return 1;
 	}
+	if (equals(name, "format"))
+	{
+		cfg_set_str(bc, BLOCK_OPT_FORMAT, is_quoted(value) ? unquote(value) : strdup(value));
+		return 1;
+	}
+	if (equals(name, "interface"))
+	{
+		cfg_set_str(bc, BLOCK_OPT_INTERFACE, is_quoted(value) ? unquote(value) : strdup(value));
+		return 1;
+	}
 	if (equals(name, "foreground") || equals(name, "fg") || equals(name, "block-foreground") || equals(name, "block-fg"))
 	{
 		cfg_set_str(bc, BLOCK_OPT_FG, is_quoted(value) ? unquote(value) : strdup(value));
@@ -233,7 +308,8 @@ int block_ini_handler(void *data, const char *section, const char *name, const c
 		}
 		else
 		{
-			block->b_type = BLOCK_TIMED;
+			// an interval of 0 means the block only runs once
+			block->b_type = atof(value) > 0.0 ? BLOCK_TIMED : BLOCK_ONCE;
 			cfg_set_float(bc, BLOCK_OPT_RELOAD, atof(value));
 		}
 		return 1;
@@ -245,22 +321,87 @@ int block_ini_handler(void *data, const char *section, const char *name, const c
 		cfg_set_float(bc, BLOCK_OPT_RELOAD, 0.0);
 		return 1;
 	}
+	if (equals(name, "timeout"))
+	{
+		cfg_set_float(bc, BLOCK_OPT_TIMEOUT, atof(value));
+		return 1;
+	}
+	if (equals(name, "prestart"))
+	{
+		cfg_set_int(bc, BLOCK_OPT_PRESTART, equals(value, "true"));
+		return 1;
+	}
 	if (equals(name, "consume"))
 	{
 		cfg_set_int(bc, BLOCK_OPT_CONSUME, equals(value, "true"));
 		return 1;
 	}
+	if (equals(name, "cache"))
+	{
+		cfg_set_float(bc, BLOCK_OPT_CACHE, atof(value));
+		return 1;
+	}
+	if (equals(name, "cache-size"))
+	{
+		cfg_set_int(bc, BLOCK_OPT_CACHE_SIZE, atoi(value));
+		return 1;
+	}
+	if (equals(name, "debounce"))
+	{
+		cfg_set_float(bc, BLOCK_OPT_DEBOUNCE, atof(value));
+		return 1;
+	}
+	if (equals(name, "throttle"))
+	{
+		cfg_set_float(bc, BLOCK_OPT_THROTTLE, atof(value));
+		return 1;
+	}
+	if (equals(name, "supersede"))
+	{
+		cfg_set_int(bc, BLOCK_OPT_SUPERSEDE, equals(value, "true"));
+		return 1;
+	}
 	if (equals(name, "live"))
 	{
 		block->b_type = BLOCK_LIVE;
 		cfg_set_int(bc, BLOCK_OPT_LIVE, equals(value, "true"));
 		return 1;
 	}
+	if (equals(name, "persistent"))
+	{
+		cfg_set_int(bc, BLOCK_OPT_PERSISTENT, equals(value, "true"));
+		return 1;
+	}
 	if (equals(name, "raw"))
 	{
 		cfg_set_int(bc, BLOCK_OPT_RAW, equals(value, "true"));
 		return 1;
 	}
+	if (equals(name, "nice"))
+	{
+		cfg_set_int(bc, BLOCK_OPT_NICE, atoi(value));
+		return 1;
+	}
+	if (equals(name, "sched"))
+	{
+		cfg_set_str(bc, BLOCK_OPT_SCHED, is_quoted(value) ? unquote(value) : strdup(value));
+		return 1;
+	}
+	if (equals(name, "ioprio"))
+	{
+		cfg_set_str(bc, BLOCK_OPT_IOPRIO, is_quoted(value) ? unquote(value) : strdup(value));
+		return 1;
+	}
+	if (equals(name, "affinity"))
+	{
+		cfg_set_str(bc, BLOCK_OPT_AFFINITY, is_quoted(value) ? unquote(value) : strdup(value));
+		return 1;
+	}
+	if (equals(name, "pipe-size"))
+	{
+		cfg_set_int(bc, BLOCK_OPT_PIPE_SIZE, atoi(value));
+		return 1;
+	}
 	if (equals(name, "mouse-left") || equals(name, "click-left"))
 	{
 		cfg_set_str(bc, BLOCK_OPT_CMD_LMB, is_quoted(value) ? unquote(value) : strdup(value));
@@ -0,0 +1,187 @@
+#include <stdlib.h>    // NULL, size_t, realloc(), free()
+#include <stdint.h>    // int64_t
+#include "succade.h"   // timer_s, sched_s
+
+/*
+ * The scheduler is a binary min-heap of timers, ordered by their deadline.
+ * Timers are owned by the user (usually embedded in a thing); the heap only
+ * holds pointers to them. Every timer remembers its position in the heap,
+ * so that rescheduling or removing a timer is O(log n) without any search.
+ * Positions are 1-based, so that a zero-initialized timer is not scheduled.
+ */
+
+static void sched_swap(sched_s *sched, size_t a, size_t b)
+{
+	timer_s *tmp = sched->heap[a];
+	sched->heap[a] = sched->heap[b];
+	sched->heap[b] = tmp;
+
+	sched->heap[a]->pos = a + 1;
+	sched->heap[b]->pos = b + 1;
+}
+
+static void sched_up(sched_s *sched, size_t i)
+{
+	while (i > 0)
+	{
+		size_t parent = (i - 1) / 2;
+		if (sched->heap[parent]->due <= sched->heap[i]->due)
+		{
+			return;
+		}
+		sched_swap(sched, i, parent);
+		i = parent;
+	}
+}
+
+static void sched_down(sched_s *sched, size_t i)
+{
+	for (;;)
+	{
+		size_t l = 2 * i + 1;
+		size_t r = 2 * i + 2;
+		size_t min = i;
+
+		if (l < sched->num && sched->heap[l]->due < sched->heap[min]->due)
+		{
+			min = l;
+		}
+		if (r < sched->num && sched->heap[r]->due < sched->heap[min]->due)
+		{
+			min = r;
+		}
+		if (min == i)
+		{
+			return;
+		}
+		sched_swap(sched, i, min);
+		i = min;
+	}
+}
+
+/*
+ * Returns 1 if the given timer is currently scheduled, otherwise 0.
+ */
+int timer_is_set(const timer_s *timer)
+{
+	return timer->pos != 0;
+}
+
+/*
+ * Schedules the timer to fire at `due` (nanoseconds, CLOCK_MONOTONIC).
+ * If the timer is already scheduled, its deadline will be updated instead.
+ * Returns 0 on success, -1 if the heap could not be grown.
+ */
+int sched_add(sched_s *sched, timer_s *timer, int64_t due)
+{
+	timer->due = due;
+
+	// already scheduled, move it up or down, depending on the new deadline
+	if (timer->pos)
+	{
+		size_t i = timer->pos - 1;
+		sched_up(sched, i);
+		sched_down(sched, timer->pos - 1);
+		return 0;
+	}
+
+	// make room for one more timer, if need be
+	if (sched->num == sched->cap)
+	{
+		size_t cap = sched->cap ? sched->cap * 2 : 16;
+		timer_s **heap = realloc(sched->heap, cap * sizeof(timer_s*));
+		if (heap == NULL)
+		{
+			return -1;
+		}
+		sched->heap = heap;
+		sched->cap  = cap;
+	}
+
+	sched->heap[sched->num] = timer;
+	timer->pos = ++sched->num;
+	sched_up(sched, sched->num - 1);
+	return 0;
+}
+
+/*
+ * Removes the timer from the scheduler, if it is scheduled.
+ */
+void sched_del(sched_s *sched, timer_s *timer)
+{
+	if (timer->pos == 0)
+	{
+		return;
+	}
+
+	size_t i    = timer->pos - 1;
+	size_t last = --sched->num;
+	timer->pos  = 0;
+
+	if (i == last)
+	{
+		return;
+	}
+
+	sched->heap[i] = sched->heap[last];
+	sched->heap[i]->pos = i + 1;
+	sched_up(sched, i);
+	sched_down(sched, sched->heap[i]->pos - 1);
+}
+
+/*
+ * Returns the timer with the earliest deadline, or NULL if none scheduled.
+ */
+timer_s *sched_peek(const sched_s *sched)
+{
+	return sched->num ? sched->heap[0] : NULL;
+}
+
+/*
+ * Removes and returns the timer with the earliest deadline, if that deadline
+ * is at or before `until`. Returns NULL if there is no such timer.
+ */
+timer_s *sched_pop(sched_s *sched, int64_t until)
+{
+	timer_s *timer = sched_peek(sched);
+	if (timer == NULL || timer->due > until)
+	{
+		return NULL;
+	}
+	sched_del(sched, timer);
+	return timer;
+}
+
+/*
+ * Returns the number of milliseconds from `now` until the earliest deadline,
+ * rounded up, so that we never wake up before it. Returns 0 if the deadline
+ * has already passed and -1 if there are no timers scheduled at all.
+ */
+int sched_wait(const sched_s *sched, int64_t now)
+{
+	timer_s *timer = sched_peek(sched);
+	if (timer == NULL)
+	{
+		return -1;
+	}
+	if (timer->due <= now)
+	{
+		return 0;
+	}
+
+	int64_t ms = (timer->due - now + NANOSEC_PER_MILLISEC - 1) / NANOSEC_PER_MILLISEC;
+	return ms > INT32_MAX ? INT32_MAX : (int) ms;
+}
+
+/*
+ * Frees the scheduler's heap. The timers themselves are owned by the caller.
+ */
+void sched_free(sched_s *sched)
+{
+	for (size_t i = 0; i < sched->num; ++i)
+	{
+		sched->heap[i]->pos = 0;
+	}
+	free(sched->heap);
+	*sched = (sched_s) { 0 };
+}
@@ -1,10 +1,12 @@
 #define CFG_IMPLEMENTATION
 #define KITA_IMPLEMENTATION
+#define _GNU_SOURCE       // clone(), CLONE_VM, ... for libkita's spawn backends
 
 #include <stdlib.h>    // NULL, size_t, EXIT_SUCCESS, EXIT_FAILURE, ...
 #include <string.h>    // strlen(), strcmp(), ...
 #include <signal.h>    // sigaction(), ... 
-#include <float.h>     // DBL_MAX
+#include <stdint.h>    // int64_t
+#include <sys/prctl.h> // prctl(), PR_SET_TIMERSLACK
 #include "ini.h"       // https://github.com/benhoyt/inih
 #include "cfg.h"
 #include "libkita.h"
@@ -12,10 +14,22 @@
 #include "options.c"   // Command line args/options parsing
 #include "helpers.c"   // Helper functions, mostly for strings
 #include "loadini.c"   // Handles loading/processing of INI cfg file
+#include "schedule.c"  // Timers and the scheduler (min-heap) for them
+#include "admit.c"     // Admission control (queue, limits) for block processes
+#include "cache.c"     // Result cache for blocks that consume their spark's output
+#include "builtin_clock.c" // Built-in block: date and time
+#include "builtin_cpu.c"   // Built-in block: CPU usage
+#include "builtin_memory.c" // Built-in block: memory and swap usage
+#include "builtin_battery.c" // Built-in block: battery and AC status
+#include "builtin_network.c" // Built-in block: network interface status
+#include "builtin.c"   // Built-in blocks, rendered without a child process
 #include "unicode.h"
 
 static volatile int running;   // used to stop main loop 
 static volatile int handled;   // last signal that has been handled 
+static volatile int dumping;   // print statistics in the next iteration
+
+static void request_frame(state_s *state, int64_t now);
 
 /*
  * Frees all members of the given thing that need freeing.
@@ -32,13 +46,16 @@ static void free_thing(thing_s *thing)
 		free(thing->output);
 	}
 
-	cfg_free(&thing->cfg);
-
-	if (thing->child)
+	if (thing->builtin && thing->builtin->close)
 	{
-		char *arg = kita_child_get_arg(thing->child);
-		free(arg);
+		thing->builtin->close(thing);
 	}
+
+	free(thing->pending);
+	free(thing->input);
+	free(thing->subs);
+	cache_free(&thing->cache);
+	cfg_free(&thing->cfg);
 }
 
 /*
@@ -99,22 +116,32 @@ int lemon_arg(thing_s *lemon, char *buf, size_t len)
 }
 
 /*
- * Runs the lemon's child process. Returns 0 on success, -1 on error.
+ * Builds the full command for lemonbar, that is, the binary followed by all 
+ * command line options and arguments. Returns the command as a dynamically 
+ * allocated string, or NULL on error.
  */
-static int open_lemon(thing_s *lemon)
+static char *lemon_cmd(thing_s *lemon)
 {
-	// Make sure we free the previous argument string, if any
-	free(kita_child_get_arg(lemon->child));
+	char arg[BUFFER_LEMON_ARG];
+	lemon_arg(lemon, arg, BUFFER_LEMON_ARG);
 
-	// Need this on the heap, as kita_child_set_arg just saves a reference
-	char *arg = malloc(BUFFER_LEMON_ARG);
-	if (arg == NULL) return -1;
+	const char *bin = cfg_get_str(&lemon->cfg, LEMON_OPT_BIN);
+	size_t len = strlen(bin) + strlen(arg) + 2;
 
-	// Actually build the lemon's argument string
-	lemon_arg(lemon, arg, BUFFER_LEMON_ARG);
+	char *cmd = malloc(len);
+	if (cmd)
+	{
+		snprintf(cmd, len, "%s %s", bin, arg);
+	}
+	return cmd;
+}
 
-	// Set the argument string, open the process, set stdin to line buffered
-	kita_child_set_arg(lemon->child, arg);
+/*
+ * Runs the lemon's child process. Returns 0 on success, -1 on error.
+ */
+static int open_lemon(thing_s *lemon)
+{
+	// Open the process, set stdin to line buffered
 	if (kita_child_open(lemon->child) == 0)
 	{
 		return kita_child_set_buf_type(lemon->child, KITA_IOS_IN, KITA_BUF_LINE);
@@ -139,21 +166,61 @@ static int open_thing(thing_s *thing)
 
 /*
  * Read from the block's stdout and save the read data, if any, in the block's 
- * output field. Returns 0 if the read data was the same as the previous data
- * already present in the output field, 1 if the newly read data is different.
+ * output field. Returns 0 if no complete line was read or if the read data was
+ * the same as the previous data already present in the output field, 1 if the
+ * newly read data is different.
  */
 static int read_block(thing_s *block)
 {
-	char *old = block->output ? strdup(block->output) : NULL;
-
-	free(block->output); // just in case, free'ing NULL is fine
-	block->output = kita_child_read(block->child, KITA_IOS_OUT);
+	const char *output = kita_child_read(block->child, KITA_IOS_OUT);
 	block->last_read = get_time();
-	
-	int same = (old && equals(old, block->output));
-	free(old);
 
-	return !same;
+	// no complete line yet, keep the previous output for now
+	if (output == NULL)
+	{
+		return 0;
+	}
+
+	// a cancelled run has nothing of interest to say anymore
+	if (block->superseded)
+	{
+		return 0;
+	}
+
+	// neither has one that timed out: what it left in the pipe when it was
+	// stopped might be cut short, so the last good output stays
+	if (block->overrun)
+	{
+		return 0;
+	}
+
+	// a persistent block has answered its request
+	block->busy = 0;
+
+	// first output of this run, update the block's runtime estimate
+	if (block->timing)
+	{
+		int64_t sample = block->last_read - block->last_open;
+		block->runtime = block->runtime ? 
+			block->runtime + (sample - block->runtime) / RUNTIME_SMOOTHING : sample;
+		block->timing = 0;
+	}
+
+	// remember the result for the input it was run with
+	if (block->input)
+	{
+		cache_put(&block->cache, block->input, output, block->last_read);
+	}
+
+	// the output is only copied if it differs from what we already have
+	if (block->output && equals(block->output, output))
+	{
+		return 0;
+	}
+
+	free(block->output); // just in case, free'ing NULL is fine
+	block->output = strdup(output);
+	return 1;
 }
 
 /*
@@ -162,8 +229,10 @@ static int read_block(thing_s *block)
  */
 static int read_spark(thing_s *spark)
 {
+	const char *output = kita_child_read(spark->child, KITA_IOS_OUT);
+
 	free(spark->output); // just in case, free'ing NULL is fine
-	spark->output = kita_child_read(spark->child, KITA_IOS_OUT);
+	spark->output = output ? strdup(output) : NULL;
 	spark->last_read = get_time();
 
 	return !empty(spark->output);
@@ -209,22 +278,82 @@ static int block_can_consume(thing_s *block)
 {
 	return block->b_type == BLOCK_SPARKED
 		&& cfg_get_int(&block->cfg, BLOCK_OPT_CONSUME) 
-		&& !empty(block->other->output);
+		&& !empty(block->pending);
 }
 
-static double block_due_in(thing_s *block, double now)
+/*
+ * Returns 1 if the block is a persistent one, that is, a timed or sparked
+ * block that is only started once and then run again via its stdin.
+ */
+static int block_is_persistent(thing_s *block)
+{
+	return (block->b_type == BLOCK_TIMED || block->b_type == BLOCK_SPARKED)
+		&& cfg_get_int(&block->cfg, BLOCK_OPT_PERSISTENT);
+}
+
+/*
+ * Returns 1 if the block is still busy with its last run, otherwise 0.
+ * For persistent blocks, that is while they haven't answered the last 
+ * request yet; for all others, it is while they are still running.
+ */
+static int block_is_busy(thing_s *block)
+{
+	return block_is_persistent(block) ? block->busy : block->alive;
+}
+
+/*
+ * Returns the block's reload interval in nanoseconds.
+ */
+static int64_t block_reload(thing_s *block)
 {
 	float reload = cfg_get_float(&block->cfg, BLOCK_OPT_RELOAD);
+	return (int64_t) (reload * NANOSEC_PER_SEC);
+}
+
+/*
+ * Returns the time at which the timed block should be run next, which is the
+ * next multiple of its interval on the wall clock after the boundary of the 
+ * last run, so that runs don't drift and blocks with the same interval are 
+ * run in step. With the prestart option, the block will be started ahead of
+ * time by its estimated runtime, but at most by half the interval, so that 
+ * slow blocks don't run all the time. The wall clock is only used for the 
+ * alignment, the result is monotonic, like `now`.
+ */
+static int64_t block_next_run(thing_s *block, int64_t now)
+{
+	int64_t reload = block_reload(block);
+	if (reload <= 0)
+	{
+		return now;
+	}
+
+	int64_t lead = 0;
+	if (cfg_get_int(&block->cfg, BLOCK_OPT_PRESTART))
+	{
+		lead = block->runtime < reload / 2 ? block->runtime : reload / 2;
+	}
 
-	return block->b_type == BLOCK_TIMED ? 
-		reload - (now - block->last_open) : 
-		DBL_MAX;
+	// the next boundary after now (plus lead, the run has to start after now),
+	// but never the last one again, in case the timer fired a little early
+	int64_t offset = get_time_real() - now;
+	int64_t next   = ((now + lead + offset) / reload + 1) * reload - offset;
+	if (next < block->boundary + reload / 2)
+	{
+		next += reload;
+	}
+	block->boundary = next;
+	return next - lead;
 }
 
-static int block_is_due(thing_s *block, double now, double tolerance)
+/*
+ * Returns 1 if the block should be run now that its timer has fired, 
+ * otherwise 0. The timer already took care of the 'when', so this only 
+ * checks whether the block's type and state allow it to be run (again).
+ */
+static int block_is_due(thing_s *block)
 {
-	// block is currently running
-	if (block->alive)
+	// block is currently running (or, if persistent, hasn't answered yet)
+	if (block_is_busy(block))
 	{
 		return 0;
 	}
@@ -232,19 +361,13 @@ static int block_is_due(thing_s *block, double now, double tolerance)
 	// One-shot blocks are due if they have never been run before
 	if (block->b_type == BLOCK_ONCE)
 	{
-		return block->last_open == 0.0;
+		return block->last_open == 0;
 	}
 
-	// Timed blocks are due if their reload time has elapsed
-	// or if they've never been run before
+	// Timed blocks are due whenever their timer fires
 	if (block->b_type == BLOCK_TIMED)
 	{
-		if (block->last_open == 0.0)
-		{
-			return 1;
-		}
-		double due_in = block_due_in(block, now);
-		return due_in < tolerance;
+		return 1;
 	}
 
 	// Sparked blocks are due if their spark has new output, or if 
@@ -258,7 +381,7 @@ static int block_is_due(thing_s *block, double now, double tolerance)
 		}
 
 		// spark has output waiting to be processed
-		if (block->other->output)
+		if (block->pending)
 		{
 			return 1;
 		}
@@ -266,14 +389,14 @@ static int block_is_due(thing_s *block, double now, double tolerance)
 		// doesn't consume and has never been run before
 		if (cfg_get_int(&block->cfg, BLOCK_OPT_CONSUME) == 0)
 		{
-			return block->last_open == 0.0;
+			return block->last_open == 0;
 		}
 	}
 
 	// Live blocks are due if they haven't been run yet 
 	if (block->b_type == BLOCK_LIVE)
 	{	
-		return block->last_open == 0.0;
+		return block->last_open == 0;
 	}
 
 	// Unknown block type (WTF?)
@@ -281,57 +404,479 @@ static int block_is_due(thing_s *block, double now, double tolerance)
 }
 
 /*
- * Opens all blocks that are due and returns the number of blocks opened.
+ * Returns the block's timeout in nanoseconds, 0 if it doesn't have one.
+ * Live blocks are meant to keep running, so they never have one.
+ */
+static int64_t block_timeout(thing_s *block)
+{
+	float timeout = cfg_get_float(&block->cfg, BLOCK_OPT_TIMEOUT);
+	if (timeout <= 0.0 || block->b_type == BLOCK_LIVE)
+	{
+		return 0;
+	}
+	return (int64_t) (timeout * NANOSEC_PER_SEC);
+}
+
+/*
+ * Timer callback for a block's timeout: the block is taking too long, so 
+ * it will be asked to stop via SIGTERM. If it is still running after the 
+ * grace period, it will be killed via SIGKILL. Either way, the whole process
+ * group is signalled, so that anything the block has started stops, too.
+ * The block's output stays what it was after its last successful run.
+ */
+static void on_block_timeout(state_s *state, timer_s *timer, int64_t now)
+{
+	thing_s *block = timer->thing;
+
+	if (block->overrun)
+	{
+		fprintf(stderr, "Block '%s' did not stop, killing it\n", block->sid);
+		++state->stats.kills;
+		kita_child_kill(block->child);
+		return;
+	}
+
+	fprintf(stderr, "Block '%s' timed out after %.1f s, terminating it\n", 
+			block->sid, (double) block_timeout(block) / NANOSEC_PER_SEC);
+	++state->stats.timeouts;
+	block->overrun = 1;
+	kita_child_term(block->child);
+	sched_add(&state->sched, &block->deadline, now + DEFAULT_TIMEOUT_GRACE * NANOSEC_PER_MILLISEC);
+}
+
+/*
+ * Starts the block's timeout for the run (or request) that has just begun,
+ * if the block has a timeout.
+ */
+static void watch_block(state_s *state, thing_s *block)
+{
+	int64_t timeout = block_timeout(block);
+	if (timeout == 0)
+	{
+		return;
+	}
+
+	block->overrun = 0;
+	block->deadline.call  = on_block_timeout;
+	block->deadline.thing = block;
+	block->deadline.exact = 1; // never cut a run short
+	sched_add(&state->sched, &block->deadline, block->last_open + timeout);
+}
+
+/*
+ * Stops the block's timeout, as its run (or request) has come to an end.
+ */
+static void unwatch_block(state_s *state, thing_s *block)
+{
+	sched_del(&state->sched, &block->deadline);
+	block->overrun = 0;
+}
+
+/*
+ * Runs a persistent block: starts it, unless it is still running from last
+ * time, then writes one line to its stdin, which the block is expected to 
+ * answer with one line of output. The line is `input`, if given, else empty.
+ * Returns 0 on success, -1 on error.
+ */
+static int tick_block(thing_s *block, const char *input)
+{
+	if (!block->alive && open_thing(block) == -1)
+	{
+		return -1;
+	}
+
+	size_t len  = (input ? strlen(input) : 0) + 2;
+	char  *line = malloc(len);
+	if (line == NULL)
+	{
+		return -1;
+	}
+	snprintf(line, len, "%s\n", input ? input : "");
+
+	int res = kita_child_feed(block->child, line);
+	free(line);
+	if (res == -1)
+	{
+		return -1;
+	}
+
+	block->busy = 1;
+	block->last_open = get_time();
+	return 0;
+}
+
+/*
+ * Opens the given block, handing it its spark's output if it consumes it.
+ * Persistent blocks get the output via stdin instead, see tick_block().
+ * Timed blocks will be scheduled for their next run right away.
+ * Returns 0 on success, -1 on error.
+ */
+static int open_block(state_s *state, thing_s *block, int64_t now)
+{
+	// the spark's output is handled now; if consumed, it is this run's input,
+	// which stays around as the key for the result cache
+	free(block->input);
+	block->input = block_can_consume(block) ? block->pending : NULL;
+	if (block->input == NULL)
+	{
+		free(block->pending);
+	}
+	block->pending = NULL;
+	block->superseded = 0;
+
+	int res = -1;
+	if (block_is_persistent(block))
+	{
+		res = tick_block(block, block->input);
+	}
+	else if (block->input)
+	{
+		kita_child_set_arg(block->child, block->input);
+		res = open_thing(block);
+		kita_child_set_arg(block->child, NULL);
+	}
+	else
+	{
+		res = open_thing(block);
+	}
+	if (res == 0)
+	{
+		block->timing = 1;
+		watch_block(state, block);
+	}
+	if (block->b_type == BLOCK_TIMED)
+	{
+		// a prestarted block must not run before its time (timer slack)
+		block->timer.exact = cfg_get_int(&block->cfg, BLOCK_OPT_PRESTART);
+		sched_add(&state->sched, &block->timer, block_next_run(block, now));
+	}
+	return res;
+}
+
+/*
+ * For blocks with a result cache: if the block has recently been run for the
+ * spark output it would consume now, it won't be run again. Instead, the 
+ * result of that run will be used, as if the block had just printed it.
+ * Returns 1 if the result was taken from the cache, otherwise 0.
+ */
+static int recall_block(state_s *state, thing_s *block, int64_t now)
+{
+	if (!cache_enabled(&block->cache) || !block_can_consume(block))
+	{
+		return 0;
+	}
+
+	const char *output = cache_get(&block->cache, block->pending, now);
+	if (output == NULL)
+	{
+		++state->stats.cache_misses;
+		return 0;
+	}
+	++state->stats.cache_hits;
+
+	// the spark's output has been dealt with, just like in open_block()
+	free(block->pending);
+	block->pending = NULL;
+
+	if (block->output && equals(block->output, output))
+	{
+		return 1;
+	}
+
+	free(block->output);
+	block->output = strdup(output);
+	request_frame(state, now);
+	return 1;
+}
+
+/*
+ * Returns 1 if running the block means creating a new process, which is 
+ * always the case, unless it is a persistent block that is still running.
+ */
+static int block_spawns(thing_s *block)
+{
+	return !(block_is_persistent(block) && block->alive);
+}
+
+/*
+ * Returns 1 if the block's process counts towards the limit of processes 
+ * running at once. Live and persistent blocks keep running, they would never
+ * give their slot back; they only count towards the spawn rate.
+ */
+static int block_takes_slot(thing_s *block)
+{
+	return block->b_type != BLOCK_LIVE && !block_is_persistent(block);
+}
+
+/*
+ * Returns the priority with which the block waits for admission: sparked 
+ * blocks react to something that just happened, so they go first.
+ */
+static admit_prio_e block_prio(thing_s *block)
+{
+	return block->b_type == BLOCK_SPARKED ? ADMIT_PRIO_URGENT : ADMIT_PRIO_NORMAL;
+}
+
+/*
+ * Opens the block via open_block() and does the bookkeeping for admission
+ * control. Returns 0 on success, -1 on error.
  */
-static size_t open_due_blocks(state_s *state, double now)
+static int spawn_block(state_s *state, thing_s *block, int64_t now)
 {
-	size_t opened = 0;
+	int spawns = block_spawns(block);
+	int res = open_block(state, block, now);
+	if (spawns)
+	{
+		admit_spawned(&state->admit, res == 0 && block_takes_slot(block), now);
+	}
+	return res;
+}
+
+/*
+ * Timer callback for admission control, also called whenever a process has
+ * given back its slot: runs as many of the waiting blocks as the limits allow,
+ * highest priority first, then in the order they were queued. If the spawn 
+ * rate is what's holding them back, schedules itself for the next token.
+ */
+static void admit_blocks(state_s *state, timer_s *timer, int64_t now)
+{
+	admit_s *admit = &state->admit;
 	thing_s *block = NULL;
-	for (size_t i = 0; i < state->num_blocks; ++i)
+	while ((block = admit_peek(admit)))
 	{
-		block = &state->blocks[i];
-		if (block_is_due(block, now, BLOCK_WAIT_TOLERANCE))
+		if (block_spawns(block) && !admit_can_spawn(admit, now))
 		{
-			if (block_can_consume(block))
-			{
-				kita_child_set_arg(block->child, block->other->output);
-				opened += (open_thing(block) == 0);
-				kita_child_set_arg(block->child, NULL);
-			}
-			else
-			{
-				opened += (open_thing(block) == 0);
-			}
-			if (block->b_type == BLOCK_SPARKED)
-			{
-				free(block->other->output);
-				block->other->output = NULL;
-			}
+			break;
+		}
+
+		int64_t waited = now - block->queued;
+		state->stats.wait_sum += waited;
+		if (waited > state->stats.wait_max)
+		{
+			state->stats.wait_max = waited;
 		}
+
+		admit_pop(admit);
+		if (block_is_due(block) && !recall_block(state, block, now))
+		{
+			spawn_block(state, block, now);
+		}
+	}
+
+	// no timer needed if it's the number of running processes holding us up
+	int64_t due = admit_next_token(admit, now);
+	if (admit->num_queued && due > now)
+	{
+		admit->timer.call  = admit_blocks;
+		admit->timer.exact = 1; // a token won't be there any earlier
+		sched_add(&state->sched, &admit->timer, due);
 	}
-	return opened;
 }
 
 /*
- * Returns the time, in seconds, until the next block should be run.
- * If no blocks are scheduled for execution, -1 will be returned.
+ * Runs the block right away, if admission control allows it, otherwise it 
+ * will be queued. Blocks never overtake waiting blocks of the same or higher
+ * priority, but do overtake those with a lower one.
  */
-static double time_to_wait(state_s *state, double now)
+static void run_block(state_s *state, thing_s *block, int64_t now)
 {
-	double lemon_due = DBL_MAX;
-	double thing_due = DBL_MAX;
+	admit_s     *admit = &state->admit;
+	admit_prio_e prio  = block_prio(block);
 
-	for (size_t i = 0; i < state->num_blocks; ++i)
+	if (block->queued || recall_block(state, block, now))
 	{
-		thing_due = block_due_in(&state->blocks[i], now);
+		return;
+	}
 
-		if (thing_due < lemon_due)
+	if (block_spawns(block) && (admit_waiting(admit, prio) || !admit_can_spawn(admit, now)))
+	{
+		admit_push(admit, block, prio, now);
+		++state->stats.queued;
+		if (admit->num_queued > state->stats.max_queued)
 		{
-			lemon_due = thing_due;
+			state->stats.max_queued = admit->num_queued;
 		}
+		admit_blocks(state, NULL, now);
+		return;
+	}
+
+	spawn_block(state, block, now);
+}
+
+/*
+ * Timer callback for blocks: runs the block if it is due. If the block is 
+ * still running from last time, it will be run as soon as it has exited 
+ * (or, if persistent, as soon as it has answered).
+ */
+static void on_block_timer(state_s *state, timer_s *timer, int64_t now)
+{
+	thing_s *block = timer->thing;
+
+	if (block_is_busy(block))
+	{
+		block->overdue = 1;
+		return;
+	}
+
+	if (block_is_due(block))
+	{
+		run_block(state, block, now);
+	}
+}
+
+/*
+ * Timer callback for built-in blocks: has the block's provider render the 
+ * block's output, requesting a frame if it has changed, then schedules the
+ * next update at the time the provider asked for, if any.
+ */
+static void on_builtin_timer(state_s *state, timer_s *timer, int64_t now)
+{
+	thing_s *block = timer->thing;
+	char buf[BUFFER_BLOCK_RESULT];
+	buf[0] = '\0';
+
+	// a trigger only ever asks for an update, its output isn't used
+	free(block->pending);
+	block->pending = NULL;
+
+	int64_t next = block->builtin->update(state, block, now, buf, sizeof(buf));
+	block->last_open = block->last_read = now;
+	++state->stats.builtins;
+
+	if (block->output == NULL || !equals(block->output, buf))
+	{
+		free(block->output);
+		block->output = strdup(buf);
+		request_frame(state, now);
 	}
 
-	return (lemon_due == DBL_MAX) ? -1 : lemon_due;
+	// providers that poll are run like timed blocks, aligned to their interval
+	if (next == 0)
+	{
+		next = block_reload(block) > 0 ? block_next_run(block, now) :
+			now + DEFAULT_BUILTIN_INTERVAL * NANOSEC_PER_MILLISEC;
+	}
+	if (next > 0)
+	{
+		// providers know exactly when their output will change
+		block->timer.exact = 1;
+		sched_add(&state->sched, &block->timer, next);
+	}
+}
+
+/*
+ * Schedules the block to be checked for a run at the given time.
+ */
+static void schedule_block(state_s *state, thing_s *block, int64_t due)
+{
+	block->timer.call  = block->builtin ? on_builtin_timer : on_block_timer;
+	block->timer.thing = block;
+	sched_add(&state->sched, &block->timer, due);
+}
+
+/*
+ * Hands the spark's latest output to the block and schedules its run, which
+ * will be delayed if the block debounces or throttles its trigger. With the
+ * supersede option, a run that is still going on will be cancelled, as its
+ * result would be out of date anyway; the block will run again once it has
+ * exited (or once the debounce delay is over, whichever is later).
+ */
+static void spark_block(state_s *state, thing_s *block, const char *output, int64_t now)
+{
+	++state->stats.sparked;
+	if (block->pending)
+	{
+		++state->stats.skipped;
+	}
+	free(block->pending);
+	block->pending = strdup(output);
+
+	if (cfg_get_int(&block->cfg, BLOCK_OPT_SUPERSEDE) && block->alive 
+			&& !block->superseded && !block_is_persistent(block))
+	{
+		++state->stats.cancelled;
+		block->superseded = 1;
+		kita_child_term(block->child);
+	}
+
+	// debounce: every new output pushes the run back
+	int64_t due = now + (int64_t) (cfg_get_float(&block->cfg, BLOCK_OPT_DEBOUNCE) * NANOSEC_PER_SEC);
+
+	// throttle: not before the interval since the last run has passed
+	int64_t throttle = cfg_get_float(&block->cfg, BLOCK_OPT_THROTTLE) * NANOSEC_PER_SEC;
+	if (throttle > 0 && block->last_open && due < block->last_open + throttle)
+	{
+		due = block->last_open + throttle;
+	}
+
+	// the timer slack shouldn't let the run happen before the delay is over
+	block->timer.exact = due > now;
+	schedule_block(state, block, due);
+}
+
+/*
+ * Fires all timers whose deadline has been reached, including those that 
+ * are due within the timer slack, so that timers with close deadlines share
+ * one wakeup. Exact timers never fire early; timers behind an exact timer 
+ * that isn't due yet will wait for it. Returns the number of timers fired.
+ */
+static size_t fire_timers(state_s *state, int64_t now)
+{
+	size_t fired = 0;
+	timer_s *timer = NULL;
+	while ((timer = sched_peek(&state->sched)))
+	{
+		if (timer->due > now + (timer->exact ? 0 : state->slack))
+		{
+			break;
+		}
+		sched_del(&state->sched, timer);
+
+		// this one would have needed a wakeup of its own otherwise
+		if (timer->due > now)
+		{
+			++state->stats.coalesced;
+		}
+		timer->call(state, timer, now);
+		++fired;
+	}
+	return fired;
+}
+
+/*
+ * Arms kita's timer for the earliest deadline in the scheduler, or disarms 
+ * it if there are no timers scheduled. The timer is only touched if the
+ * deadline has changed. Returns 0 on success, -1 on error.
+ */
+static int arm_timer(state_s *state)
+{
+	timer_s *next = sched_peek(&state->sched);
+	int64_t  due  = next ? next->due : -1;
+
+	if (due == state->armed)
+	{
+		return 0;
+	}
+
+	struct timespec ts = { .tv_sec = due / NANOSEC_PER_SEC, .tv_nsec = due % NANOSEC_PER_SEC };
+	if (kita_set_timer(state->kita, due == -1 ? NULL : &ts) == -1)
+	{
+		state->armed = -1;
+		return -1;
+	}
+
+	state->armed = due;
+	return 0;
+}
+
+/*
+ * Returns the time, in milliseconds, until the next timer is due, rounded up.
+ * If no timers are scheduled, -1 will be returned. Never returns a negative 
+ * value other than -1, so epoll_pwait() won't block indefinitely by accident.
+ */
+static int time_to_wait(state_s *state, int64_t now)
+{
+	return sched_wait(&state->sched, now);
 }
 
 /*
@@ -499,18 +1044,166 @@ int blockstr(const thing_s *lemon, const thing_s *block, char *buf, size_t len,
 		margin_r
 	);
 
-	free(result);
-	return res;
+	free(result);
+	return res;
+}
+
+/*
+ * Returns 'l', 'c' or 'r' for input values -1, 0 and 1 respectively.
+ * For other input values, the behavior is undefined.
+ */
+static char get_align(const int align)
+{
+	char a[] = {'l', 'c', 'r'};
+	return a[align+1]; 
+}
+
+/*
+ * Returns the kita spawn type for the given name, which should be one of
+ * "fork", "vfork", "clone", "posix_spawn" or "zygote", or -1 if the name 
+ * is unknown.
+ */
+static int get_spawn_type(const char *name)
+{
+	if (equals(name, "fork"))
+	{
+		return KITA_SPAWN_FORK;
+	}
+	if (equals(name, "vfork"))
+	{
+		return KITA_SPAWN_VFORK;
+	}
+	if (equals(name, "clone"))
+	{
+		return KITA_SPAWN_CLONE;
+	}
+	if (equals(name, "posix_spawn") || equals(name, "posix-spawn"))
+	{
+		return KITA_SPAWN_POSIX;
+	}
+	if (equals(name, "zygote"))
+	{
+		return KITA_SPAWN_ZYGOTE;
+	}
+	return -1;
+}
+
+/*
+ * Returns the scheduling policy with the given name, or -1 if unknown.
+ */
+static int get_sched_policy(const char *name)
+{
+	if (equals(name, "normal") || equals(name, "other"))
+	{
+		return SCHED_OTHER;
+	}
+	if (equals(name, "batch"))
+	{
+		return SCHED_BATCH;
+	}
+	if (equals(name, "idle"))
+	{
+		return SCHED_IDLE;
+	}
+	return -1;
+}
+
+/*
+ * Returns the I/O scheduling class given as "class" or "class:level", with 
+ * class being one of "realtime", "best-effort" or "idle", and saves the level
+ * in `level`; it defaults to 4 if not given (and is always 0 for "idle").
+ * Returns -1 if the class is unknown or the level isn't within 0 to 7.
+ */
+static int get_io_class(const char *name, int *level)
+{
+	const char *colon = strchr(name, ':');
+	int len = colon ? (int) (colon - name) : (int) strlen(name);
+
+	char class[16];
+	snprintf(class, sizeof(class), "%.*s", len, name);
+
+	*level = colon ? atoi(colon + 1) : 4;
+	if (*level < 0 || *level > 7)
+	{
+		return -1;
+	}
+
+	if (equals(class, "realtime") || equals(class, "rt"))
+	{
+		return KITA_IO_RT;
+	}
+	if (equals(class, "best-effort") || equals(class, "be"))
+	{
+		return KITA_IO_BE;
+	}
+	if (equals(class, "idle"))
+	{
+		*level = 0;
+		return KITA_IO_IDLE;
+	}
+	return -1;
 }
 
 /*
- * Returns 'l', 'c' or 'r' for input values -1, 0 and 1 respectively.
- * For other input values, the behavior is undefined.
+ * Reads the priority options (nice value, scheduling policy, I/O priority 
+ * and CPU affinity), at the given option indices, from the config into 
+ * `prio`. Invalid values will be reported, using the config's `sid`, and 
+ * ignored. Returns non-zero if any of the options have been set.
  */
-static char get_align(const int align)
+static int get_prio(const cfg_s *cfg, const char *sid, kita_prio_s *prio,
+		int opt_nice, int opt_sched, int opt_ioprio, int opt_affinity)
 {
-	char a[] = {'l', 'c', 'r'};
-	return a[align+1]; 
+	*prio = (kita_prio_s) { 0 };
+
+	if (cfg_has(cfg, opt_nice))
+	{
+		prio->nice = cfg_get_int(cfg, opt_nice);
+		prio->set |= KITA_PRIO_NICE;
+	}
+
+	const char *sched = cfg_get_str(cfg, opt_sched);
+	if (sched)
+	{
+		prio->sched = get_sched_policy(sched);
+		if (prio->sched == -1)
+		{
+			fprintf(stderr, "Unknown scheduling policy '%s' for '%s'\n", sched, sid);
+		}
+		else
+		{
+			prio->set |= KITA_PRIO_SCHED;
+		}
+	}
+
+	const char *ioprio = cfg_get_str(cfg, opt_ioprio);
+	if (ioprio)
+	{
+		prio->io_class = get_io_class(ioprio, &prio->io_level);
+		if (prio->io_class == -1)
+		{
+			fprintf(stderr, "Invalid I/O priority '%s' for '%s'\n", ioprio, sid);
+		}
+		else
+		{
+			prio->set |= KITA_PRIO_IO;
+		}
+	}
+
+	const char *affinity = cfg_get_str(cfg, opt_affinity);
+	if (affinity)
+	{
+		prio->cpus = cpu_list(affinity);
+		if (prio->cpus == 0)
+		{
+			fprintf(stderr, "Invalid list of CPUs '%s' for '%s'\n", affinity, sid);
+		}
+		else
+		{
+			prio->set |= KITA_PRIO_CPUS;
+		}
+	}
+
+	return prio->set;
 }
 
 /*
@@ -557,8 +1250,18 @@ static char *barstr(const state_s *state)
 		int block_align = cfg_get_int(&block->cfg, BLOCK_OPT_ALIGN);
 		int same_align = block_align == last_align;
 
-		// Build the block string
-		int block_str_len = blockstr(&state->lemon, block, block_str, BUFFER_BLOCK_STR, real_block); 
+		// Build the block string (might have been truncated to the buffer)
+		blockstr(&state->lemon, block, block_str, BUFFER_BLOCK_STR, real_block); 
+
+		// Let's check if alignment, separator, block string, newline and 
+		// null terminator can all fit in our buffer
+		size_t need = strlen(bar_str) + 4 + sep_len + strlen(block_str) + 2;
+		if (need > bar_str_len)
+		{
+			// Let's make space for approx. two more blocks
+			bar_str_len = need + BUFFER_BLOCK_RESULT * 2; 
+			bar_str = realloc(bar_str, bar_str_len);
+		}
 
 		// Potentially change the alignment
 		if (!same_align)
@@ -567,15 +1270,6 @@ static char *barstr(const state_s *state)
 			snprintf(align, 5, "%%{%c}", get_align(last_align));
 			strcat(bar_str, align);
 		}
-		
-		// Let's check if this block string can fit in our buffer
-		size_t free_len = bar_str_len - (strlen(bar_str) + sep_len + 1);
-		if (block_str_len > free_len)
-		{
-			// Let's make space for approx. two more blocks
-			bar_str_len += BUFFER_BLOCK_RESULT * 2; 
-			bar_str = realloc(bar_str, bar_str_len);
-		}
 
 		// Possibly add the block separator in front of the block
 		if (sep && same_align && i)
@@ -793,53 +1487,79 @@ static int load_block_cfg(state_s *state)
 	return ini_parse(state->prefs.config, block_cfg_handler, state);
 }
 
-static thing_s *get_spark(state_s *state, void *block, const char *cmd)
+/*
+ * Finds and returns the spark running the given command -- or NULL.
+ */
+static thing_s *get_spark(state_s *state, const char *cmd)
 {
 	for (size_t i = 0; i < state->num_sparks; ++i)
 	{
-		if (state->sparks[i].other != block)
-		{
-			continue;
-		}
-		if (!equals(state->sparks[i].child->cmd, cmd))
+		if (equals(state->sparks[i].child->cmd, cmd))
 		{
-			continue;
+			return &state->sparks[i];
 		}
-		return &state->sparks[i];
 	}
 	return NULL;
 }
 
+/*
+ * Subscribes the block to the spark running the given command, creating the
+ * spark first if there is none yet. All blocks with the same trigger share
+ * one spark, that is, one process. Note that this might move all sparks in 
+ * memory, so the blocks only get their reference to their spark once all of
+ * them have been added, see create_sparks().
+ * Returns the spark or NULL on error.
+ */
 static thing_s *add_spark(state_s *state, thing_s *block, const char *cmd)
 {
-	// See if there is an existing spark that matches the given params
-	thing_s *es = get_spark(state, block, cmd);
-	if (es)
+	// See if there is an existing spark that runs the same command
+	thing_s *spark = get_spark(state, cmd);
+	if (spark == NULL)
 	{
-		return es;
+		kita_child_s *child = make_child(state, cmd, 0, 1, 0);
+		if (child == NULL)
+		{
+			return NULL;
+		}
+
+		// Resize the spark array to be able to hold one more spark
+		size_t current  =   state->num_sparks;
+		size_t new_size = ++state->num_sparks * sizeof(thing_s);
+		thing_s *sparks = realloc(state->sparks, new_size);
+		if (sparks == NULL)
+		{
+			fprintf(stderr, "add_spark(): realloc() failed!\n");
+			--state->num_sparks;
+			kita_child_free(&child);
+			return NULL;
+		}
+		state->sparks = sparks; 
+
+		spark = &state->sparks[current];
+		*spark = (thing_s) { 0 };
+		spark->t_type = THING_SPARK;
+		spark->child  = child;
+
+		// the trigger runs with the same priority as its (first) block
+		kita_prio_s prio;
+		if (get_prio(&block->cfg, block->sid, &prio, 
+					BLOCK_OPT_NICE, BLOCK_OPT_SCHED, BLOCK_OPT_IOPRIO, BLOCK_OPT_AFFINITY))
+		{
+			kita_child_set_prio(spark->child, &prio);
+		}
 	}
 
-	// Resize the spark array to be able to hold one more spark
-	size_t current  =   state->num_sparks;
-	size_t new_size = ++state->num_sparks * sizeof(thing_s);
-	thing_s *sparks = realloc(state->sparks, new_size);
-	if (sparks == NULL)
+	// Add the block to the spark's subscribers
+	thing_s **subs = realloc(spark->subs, (spark->num_subs + 1) * sizeof(thing_s*));
+	if (subs == NULL)
 	{
 		fprintf(stderr, "add_spark(): realloc() failed!\n");
-		--state->num_sparks;
 		return NULL;
 	}
-	state->sparks = sparks; 
-	 
-	state->sparks[current] = (thing_s) { 0 };
-	state->sparks[current].t_type = THING_SPARK;
-	state->sparks[current].other  = block;
-
-	// Add a reference of this spark to the block we've created it for
-	block->other = &state->sparks[current];
+	spark->subs = subs;
+	spark->subs[spark->num_subs++] = block;
 
-	// Return a pointer to the new spark
-	return &state->sparks[current];
+	return spark;
 }
 
 static size_t create_sparks(state_s *state)
@@ -864,10 +1584,13 @@ static size_t create_sparks(state_s *state)
 		add_spark(state, block, trigger);
 	}
 
+	// all sparks are in place now, let the blocks know about theirs
 	for (size_t i = 0; i < state->num_sparks; ++i)
 	{
-		char *trigger = cfg_get_str(&state->sparks[i].other->cfg, BLOCK_OPT_TRIGGER);
-		state->sparks[i].child = make_child(state, trigger, 0, 1, 0);
+		for (size_t s = 0; s < state->sparks[i].num_subs; ++s)
+		{
+			state->sparks[i].subs[s]->other = &state->sparks[i];
+		}
 	}
 
 	return state->num_sparks;
@@ -876,11 +1599,15 @@ static size_t create_sparks(state_s *state)
 /*
  * Run a command in a 'fire and forget' manner. Does not invoke a shell,
  * hence no shell built-in functionality can be used in the command.
+ * The child is tracked by kita, so that it will be reaped once it exits,
+ * at which point on_child_reaped() will free it. Commands are run right 
+ * away, ahead of any blocks waiting for admission, but they do take up a
+ * slot, so that blocks have to wait for them if the limit has been reached.
  * Returns 0 on success, -1 on error.
  */
-int run_cmd(const char *cmd)
+static int run_cmd(state_s *state, const char *cmd)
 {
-	kita_child_s *child = kita_child_new(cmd, 0, 0, 0);
+	kita_child_s *child = make_child(state, cmd, 0, 0, 0);
 	if (child == NULL)
 	{
 		return -1;
@@ -888,11 +1615,12 @@ int run_cmd(const char *cmd)
 
 	if (kita_child_open(child) == -1) // runs the child via fork/execvp
 	{
+		kita_child_free(&child);
 		return -1;
 	}
 
-	kita_child_close(child); // does not stop the child, just closes com channels
-	kita_child_free(&child);
+	admit_spawned(&state->admit, 1, get_time());
+
 	return 0;
 }
 
@@ -903,7 +1631,7 @@ int run_cmd(const char *cmd)
  * Returns 0 on success, -1 if the string was not a recognized action command
  * or the block that the action belongs to could not be found.
  */
-static int process_action(const state_s *state, const char *action)
+static int process_action(state_s *state, const char *action)
 {
 	// A valid action command should have the format <blockname>_<cmd-type>
 	// For example, for a block named `datetime` that was clicked with the 
@@ -933,40 +1661,79 @@ static int process_action(const state_s *state, const char *action)
 	// Now to fire the right command for the action type
 	if (equals(type, "_lmb"))
 	{
-		return run_cmd(cfg_get_str(&source->cfg, BLOCK_OPT_CMD_LMB));
+		return run_cmd(state, cfg_get_str(&source->cfg, BLOCK_OPT_CMD_LMB));
 	}
 	if (equals(type, "_mmb"))
 	{
-		return run_cmd(cfg_get_str(&source->cfg, BLOCK_OPT_CMD_MMB));
+		return run_cmd(state, cfg_get_str(&source->cfg, BLOCK_OPT_CMD_MMB));
 	}
 	if (equals(type, "_rmb"))
 	{
-		return run_cmd(cfg_get_str(&source->cfg, BLOCK_OPT_CMD_RMB));
+		return run_cmd(state, cfg_get_str(&source->cfg, BLOCK_OPT_CMD_RMB));
 	}
 	if (equals(type, "_sup"))
 	{
-		return run_cmd(cfg_get_str(&source->cfg, BLOCK_OPT_CMD_SUP));
+		return run_cmd(state, cfg_get_str(&source->cfg, BLOCK_OPT_CMD_SUP));
 	}
 	if (equals(type, "_sdn"))
 	{
-		return run_cmd(cfg_get_str(&source->cfg, BLOCK_OPT_CMD_SDN));
+		return run_cmd(state, cfg_get_str(&source->cfg, BLOCK_OPT_CMD_SDN));
 	}
 
 	// Invalid action type (how in the world did that happen?)
 	return -1;
 }
 
-static void feed_lemon(state_s *state)
+/*
+ * Timer callback for the bar: sends a frame with the current output of all 
+ * blocks to the bar, merging all changes since the last frame.
+ */
+static void feed_lemon(state_s *state, timer_s *timer, int64_t now)
 {
-	if (state->due == 0)
-	{
-		return;
-	}
-
 	char *input = barstr(state);
 	kita_child_feed(state->lemon.child, input);
 	free(input);
-	state->due = 0;
+
+	state->frame.first = 0;
+	state->frame.sent  = now;
+	++state->stats.frames;
+}
+
+/*
+ * Notes that a block's output has changed and schedules a frame for it. 
+ * The frame waits for further changes for as long as the coalescing window, 
+ * and at least until the minimum frame interval has passed since the last 
+ * frame, but no longer than the latency limit allows, counted from the first 
+ * change that went into it. If a frame is already pending, the change will be
+ * merged into it.
+ */
+static void request_frame(state_s *state, int64_t now)
+{
+	frame_s *frame = &state->frame;
+
+	if (frame->first == 0)
+	{
+		frame->first = now;
+	}
+	else
+	{
+		++state->stats.merged;
+	}
+	frame->last = now;
+
+	int64_t due = frame->last + frame->coalesce;
+	if (due < frame->sent + frame->interval)
+	{
+		due = frame->sent + frame->interval;
+	}
+	if (due > frame->first + frame->latency)
+	{
+		due = frame->first + frame->latency;
+	}
+
+	frame->timer.call  = feed_lemon;
+	frame->timer.exact = 1;
+	sched_add(&state->sched, &frame->timer, due);
 }
 
 /*
@@ -1004,6 +1771,49 @@ void on_signal(int sig)
 	handled = sig;
 }
 
+/*
+ * Handles SIGUSR1 by setting the static variable `dumping` to 1, so that
+ * the main loop will print the current statistics in its next iteration.
+ */
+void on_dump(int sig)
+{
+	dumping = 1;
+}
+
+/*
+ * Prints the runtime statistics to the given stream.
+ */
+static void print_stats(state_s *state, FILE *where)
+{
+	const kita_stats_s *ks = kita_get_stats(state->kita);
+
+	fprintf(where, "ticks:  %lu\n", ks->ticks);
+	fprintf(where, "events: %lu (%.2f per tick, max. %d)\n", ks->events,
+			ks->ticks ? (double) ks->events / ks->ticks : 0.0, ks->max_batch);
+	fprintf(where, "timer wakeups: %lu (%lu saved by coalescing)\n",
+			state->stats.wakeups, state->stats.coalesced);
+	fprintf(where, "frames: %lu (%lu changes merged)\n",
+			state->stats.frames, state->stats.merged);
+	fprintf(where, "timeouts: %lu (%lu killed)\n",
+			state->stats.timeouts, state->stats.kills);
+	fprintf(where, "frames fed: %lu (%lu superseded, %lu dropped)\n",
+			ks->feeds, ks->superseded, ks->dropped);
+	unsigned long admitted = state->stats.queued - state->admit.num_queued;
+	fprintf(where, "admission: %zu waiting, %lu queued (max. %zu at once), "
+			"waited %.1f ms on average, max. %.1f ms\n",
+			state->admit.num_queued, state->stats.queued, state->stats.max_queued,
+			admitted ? (double) state->stats.wait_sum / admitted / NANOSEC_PER_MILLISEC : 0.0,
+			(double) state->stats.wait_max / NANOSEC_PER_MILLISEC);
+	unsigned long lookups = state->stats.cache_hits + state->stats.cache_misses;
+	fprintf(where, "cache: %lu hits, %lu misses (%.1f%% hit rate)\n",
+			state->stats.cache_hits, state->stats.cache_misses,
+			lookups ? 100.0 * state->stats.cache_hits / lookups : 0.0);
+	fprintf(where, "triggered: %lu (%lu skipped for newer ones, %lu runs cancelled)\n",
+			state->stats.sparked, state->stats.skipped, state->stats.cancelled);
+	fprintf(where, "built-in updates: %lu (%lu events)\n", 
+			state->stats.builtins, state->stats.notified);
+}
+
 static thing_s *thing_by_child(state_s *state, kita_child_s *child)
 {
 	// lemon
@@ -1035,6 +1845,31 @@ static thing_s *thing_by_child(state_s *state, kita_child_s *child)
 	return NULL;
 }
 
+void on_timer(kita_state_s *ks, kita_event_s *ke)
+{
+	state_s *state = (state_s*) kita_get_context(ks);
+
+	// the timer is disarmed now, it needs to be armed again
+	state->armed = -1;
+	++state->stats.wakeups;
+}
+
+void on_fd_readok(kita_state_s *ks, kita_event_s *ke)
+{
+	state_s *state = (state_s*) kita_get_context(ks);
+	thing_s *block = (thing_s*) ke->ctx;
+
+	// the built-in that watches the fd decides whether the block needs updating
+	if (block && block->builtin && block->builtin->event)
+	{
+		++state->stats.notified;
+		if (block->builtin->event(state, block, ke->fd))
+		{
+			schedule_block(state, block, get_time());
+		}
+	}
+}
+
 void on_child_error(kita_state_s *ks, kita_event_s *ke)
 {
 	//fprintf(stderr, "on_child_error(): %s\n", ke->child->cmd);
@@ -1045,11 +1880,6 @@ void on_child_readok(kita_state_s *ks, kita_event_s *ke)
 {
 	//fprintf(stderr, "on_child_readok(): %s (%d bytes)\n", ke->child->cmd, ke->size);
 
-	if (ke->size == 0)
-	{
-		return;
-	}
-
 	state_s *state = (state_s*) kita_child_get_context(ke->child);
 	thing_s *thing = thing_by_child(state, ke->child);
 
@@ -1062,9 +1892,11 @@ void on_child_readok(kita_state_s *ks, kita_event_s *ke)
 	{
 		if (ke->ios == KITA_IOS_OUT)
 		{
-			char *output = kita_child_read(ke->child, ke->ios);
-			process_action(state, output);
-			free(output);
+			const char *output = kita_child_read(ke->child, ke->ios);
+			if (output)
+			{
+				process_action(state, output);
+			}
 		}
 		else
 		{
@@ -1072,7 +1904,11 @@ void on_child_readok(kita_state_s *ks, kita_event_s *ke)
 			//      - ... will be ignored
 			//      - ... will be printed to stderr
 			//      - ... will be logged to a file
-			fprintf(stderr, "%s\n", kita_child_read(ke->child, ke->ios));
+			const char *output = kita_child_read(ke->child, ke->ios);
+			if (output)
+			{
+				fprintf(stderr, "%s\n", output);
+			}
 		}
 		return;
 	}
@@ -1085,7 +1921,20 @@ void on_child_readok(kita_state_s *ks, kita_event_s *ke)
 			// different from its previous output
 			if (read_block(thing))
 			{
-				state->due = 1;
+				request_frame(state, thing->last_read);
+			}
+
+			// persistent block has answered, it's on time
+			if (block_is_persistent(thing) && !thing->busy)
+			{
+				unwatch_block(state, thing);
+			}
+
+			// persistent block has answered, but was due again already
+			if (thing->overdue && !block_is_busy(thing))
+			{
+				thing->overdue = 0;
+				schedule_block(state, thing, get_time());
 			}
 		}
 		else
@@ -1098,9 +1947,15 @@ void on_child_readok(kita_state_s *ks, kita_event_s *ke)
 
 	if (thing->t_type == THING_SPARK)
 	{
-		if (ke->ios == KITA_IOS_OUT)
+		if (ke->ios == KITA_IOS_OUT && read_spark(thing))
 		{
-			read_spark(thing);
+			// every block gets its own copy of the output, as they handle
+			// it in their own time, according to their own trigger options
+			int64_t now = get_time();
+			for (size_t s = 0; s < thing->num_subs; ++s)
+			{
+				spark_block(state, thing->subs[s], thing->output, now);
+			}
 		}
 		return;
 	}
@@ -1111,6 +1966,15 @@ void on_child_closed(kita_state_s *ks, kita_event_s *ke)
 	//fprintf(stderr, "on_child_closed(): %s\n", ke->child->cmd);
 }
 
+void on_child_hangup(kita_state_s *ks, kita_event_s *ke)
+{
+	//fprintf(stderr, "on_child_hangup(): %s\n", ke->child->cmd);
+
+	// a child that closed one of its streams may well keep running; kita has
+	// handed out what was left in the stream (READOK) and closes it after
+	// this, the child's admission slot and watchdog stay until it has exited
+}
+
 void on_child_exited(kita_state_s *ks, kita_event_s *ke)
 {
 	//fprintf(stderr, "on_child_exited(): %s\n", ke->child->cmd);
@@ -1131,7 +1995,28 @@ void on_child_exited(kita_state_s *ks, kita_event_s *ke)
 
 	if (thing->t_type == THING_BLOCK)
 	{
+		// give back the slot, one of the waiting blocks can have it
+		int slot = thing->alive && block_takes_slot(thing);
+		if (slot)
+		{
+			admit_done(&state->admit);
+		}
+
 		thing->alive = 0;
+		thing->busy  = 0;
+		unwatch_block(state, thing);
+
+		if (slot)
+		{
+			admit_blocks(state, NULL, get_time());
+		}
+
+		// block became due while it was still running, run it again
+		if (thing->overdue)
+		{
+			thing->overdue = 0;
+			schedule_block(state, thing, get_time());
+		}
 		return;
 	}
 	
@@ -1145,11 +2030,36 @@ void on_child_exited(kita_state_s *ks, kita_event_s *ke)
 void on_child_reaped(kita_state_s *ks, kita_event_s *ke)
 {
 	//fprintf(stderr, "on_child_reaped(): %s\n", ke->child->cmd);
-	on_child_exited(ks, ke);
+
+	state_s *state = (state_s*) kita_child_get_context(ke->child);
+
+	// children that don't belong to any thing were started by run_cmd()
+	if (thing_by_child(state, ke->child) == NULL)
+	{
+		kita_child_free(&ke->child);
+		admit_done(&state->admit);
+		admit_blocks(state, NULL, get_time());
+	}
+
+	// things have been taken care of by on_child_exited() already, which
+	// kita dispatches right before this, for every child it reaps
 }
 
 static void cleanup(state_s *state)
 {
+	// blocks with a timeout run in process groups of their own, so they 
+	// won't get signals from the terminal meant for us; pass them on
+	for (size_t i = 0; i < state->num_blocks; ++i)
+	{
+		if (state->blocks[i].alive && block_timeout(&state->blocks[i]))
+		{
+			kita_child_term(state->blocks[i].child);
+		}
+	}
+
+	// free timers (before the things they are embedded in)
+	sched_free(&state->sched);
+
 	// free sparks
 	free_sparks(state);
 	free(state->sparks);
@@ -1159,6 +2069,16 @@ static void cleanup(state_s *state)
 	// free albedo
 	free_thing(&state->albedo);
 
+	// free the blocks' parsed labels and affixes, while we know how many
+	for (size_t i = 0; state->real_blocks && i < state->num_blocks; ++i)
+	{
+		free(state->real_blocks[i].label);
+		free(state->real_blocks[i].prefix);
+		free(state->real_blocks[i].suffix);
+	}
+	free(state->real_blocks);
+	state->real_blocks = NULL;
+
 	// free blocks
 	free_blocks(state);
 	free(state->blocks);
@@ -1173,14 +2093,7 @@ static void cleanup(state_s *state)
 	state->kita = NULL;
 
 	// misc
-	state->due = 0;
-
-	for(int i=0;i< state->num_blocks; i++){
-		free(state->real_blocks[i].label);
-		free(state->real_blocks[i].prefix);
-		free(state->real_blocks[i].suffix);
-	}
-	free(state->real_blocks);
+	state->frame = (frame_s) { 0 };
 }
 
 // http://courses.cms.caltech.edu/cs11/material/general/usage.html
@@ -1216,6 +2129,10 @@ int main(int argc, char **argv)
 	sigaction(SIGQUIT, &sa_int, NULL);
 	sigaction(SIGTERM, &sa_int, NULL);
 	sigaction(SIGPIPE, &sa_int, NULL);
+
+	struct sigaction sa_usr = { .sa_handler = &on_dump };
+
+	sigaction(SIGUSR1, &sa_usr, NULL);
 	
 	//
 	// CHECK FOR X 
@@ -1248,6 +2165,8 @@ int main(int argc, char **argv)
 
 	kita_state_s *kita = state.kita; // For convenience
 	kita_set_option(kita, KITA_OPT_NO_NEWLINE, 1);
+	kita_set_context(kita, &state);
+	state.armed = -1;
 
 	// 
 	// KITA CALLBACKS 
@@ -1255,10 +2174,12 @@ int main(int argc, char **argv)
 
 	kita_set_callback(kita, KITA_EVT_CHILD_CLOSED, on_child_closed);
 	kita_set_callback(kita, KITA_EVT_CHILD_REAPED, on_child_reaped);
-	kita_set_callback(kita, KITA_EVT_CHILD_HANGUP, on_child_exited);
+	kita_set_callback(kita, KITA_EVT_CHILD_HANGUP, on_child_hangup);
 	kita_set_callback(kita, KITA_EVT_CHILD_EXITED, on_child_exited);
 	kita_set_callback(kita, KITA_EVT_CHILD_READOK, on_child_readok);
 	kita_set_callback(kita, KITA_EVT_CHILD_ERROR,  on_child_error);
+	kita_set_callback(kita, KITA_EVT_TIMER,        on_timer);
+	kita_set_callback(kita, KITA_EVT_FD_READOK,    on_fd_readok);
 
 	//
 	// COMMAND LINE ARGUMENTS
@@ -1338,9 +2259,104 @@ int main(int argc, char **argv)
 		cfg_set_int(&lemon->cfg, LEMON_OPT_AREAS, 0);
 	}
 
-	// create the child process and add it to the kita state
+	// if no 'timer-slack' option was present in the config, use the default
+	if (!cfg_has(&lemon->cfg, LEMON_OPT_TIMER_SLACK))
+	{
+		cfg_set_int(&lemon->cfg, LEMON_OPT_TIMER_SLACK, DEFAULT_TIMER_SLACK);
+	}
+
+	// if no 'max-events' option was present in the config, use the default
+	if (!cfg_has(&lemon->cfg, LEMON_OPT_MAX_EVENTS))
+	{
+		cfg_set_int(&lemon->cfg, LEMON_OPT_MAX_EVENTS, DEFAULT_MAX_EVENTS);
+	}
+	if (kita_set_max_events(kita, cfg_get_int(&lemon->cfg, LEMON_OPT_MAX_EVENTS)) == -1)
+	{
+		fprintf(stderr, "Invalid number of events '%d', using %d\n",
+				cfg_get_int(&lemon->cfg, LEMON_OPT_MAX_EVENTS), KITA_MAX_EVENTS);
+	}
+
+	// if no frame options were present in the config, use the defaults
+	if (!cfg_has(&lemon->cfg, LEMON_OPT_FRAME_INTERVAL))
+	{
+		cfg_set_int(&lemon->cfg, LEMON_OPT_FRAME_INTERVAL, DEFAULT_FRAME_INTERVAL);
+	}
+	if (!cfg_has(&lemon->cfg, LEMON_OPT_FRAME_COALESCE))
+	{
+		cfg_set_int(&lemon->cfg, LEMON_OPT_FRAME_COALESCE, DEFAULT_FRAME_COALESCE);
+	}
+	if (!cfg_has(&lemon->cfg, LEMON_OPT_FRAME_LATENCY))
+	{
+		cfg_set_int(&lemon->cfg, LEMON_OPT_FRAME_LATENCY, DEFAULT_FRAME_LATENCY);
+	}
+
+	state.frame.interval = cfg_get_int(&lemon->cfg, LEMON_OPT_FRAME_INTERVAL) * NANOSEC_PER_MILLISEC;
+	state.frame.coalesce = cfg_get_int(&lemon->cfg, LEMON_OPT_FRAME_COALESCE) * NANOSEC_PER_MILLISEC;
+	state.frame.latency  = cfg_get_int(&lemon->cfg, LEMON_OPT_FRAME_LATENCY)  * NANOSEC_PER_MILLISEC;
+
+	// priority for ourselves, which the bar, the zygote (if any) and, by
+	// default, all blocks inherit; so this needs to happen before spawning
+	kita_prio_s prio;
+	if (get_prio(&lemon->cfg, lemon->sid, &prio, 
+				LEMON_OPT_NICE, LEMON_OPT_SCHED, LEMON_OPT_IOPRIO, LEMON_OPT_AFFINITY)
+			&& kita_apply_prio(&prio) == -1)
+	{
+		fprintf(stderr, "Failed to apply some of the priority options for '%s'\n", lemon->sid);
+	}
+
+	// if no 'spawn' option was present in the config, use the default
+	if (!cfg_has(&lemon->cfg, LEMON_OPT_SPAWN))
+	{
+		cfg_set_str(&lemon->cfg, LEMON_OPT_SPAWN, strdup(DEFAULT_SPAWN));
+	}
+
+	// pick the method used to create child processes, fork being the fallback
+	int spawn = get_spawn_type(cfg_get_str(&lemon->cfg, LEMON_OPT_SPAWN));
+	if (spawn == -1)
+	{
+		fprintf(stderr, "Unknown spawn method '%s', using 'fork'\n", 
+				cfg_get_str(&lemon->cfg, LEMON_OPT_SPAWN));
+		spawn = KITA_SPAWN_FORK;
+	}
+	if (kita_set_spawn(kita, spawn) == -1)
+	{
+		fprintf(stderr, "Failed to set up spawn method '%s', using 'fork'\n",
+				cfg_get_str(&lemon->cfg, LEMON_OPT_SPAWN));
+		kita_set_spawn(kita, KITA_SPAWN_FORK);
+	}
+
+	// if no admission control options were present in the config, use the defaults
+	if (!cfg_has(&lemon->cfg, LEMON_OPT_MAX_RUNNING))
+	{
+		cfg_set_int(&lemon->cfg, LEMON_OPT_MAX_RUNNING, DEFAULT_MAX_RUNNING);
+	}
+	if (!cfg_has(&lemon->cfg, LEMON_OPT_SPAWN_RATE))
+	{
+		cfg_set_float(&lemon->cfg, LEMON_OPT_SPAWN_RATE, DEFAULT_SPAWN_RATE);
+	}
+	if (!cfg_has(&lemon->cfg, LEMON_OPT_SPAWN_BURST))
+	{
+		cfg_set_int(&lemon->cfg, LEMON_OPT_SPAWN_BURST, DEFAULT_SPAWN_BURST);
+	}
+
+	admit_init(&state.admit,
+			cfg_get_int(&lemon->cfg, LEMON_OPT_MAX_RUNNING),
+			cfg_get_float(&lemon->cfg, LEMON_OPT_SPAWN_RATE),
+			cfg_get_int(&lemon->cfg, LEMON_OPT_SPAWN_BURST));
+
+	// let the kernel group our own timers the same way (0 means default)
+	state.slack = cfg_get_int(&lemon->cfg, LEMON_OPT_TIMER_SLACK) * NANOSEC_PER_MILLISEC;
+	if (state.slack > 0)
+	{
+		prctl(PR_SET_TIMERSLACK, (unsigned long) state.slack, 0, 0, 0);
+	}
+
+	// create the child process and add it to the kita state; the options 
+	// are part of the command, so it only needs to be expanded once
 	char *lemon_bin = cfg_get_str(&lemon->cfg, LEMON_OPT_BIN);
-	lemon->child = make_child(&state, lemon_bin, 1, 1, 1);
+	char *lemon_str = lemon_cmd(lemon);
+	lemon->child = lemon_str ? make_child(&state, lemon_str, 1, 1, 1) : NULL;
+	free(lemon_str);
 	if (lemon->child == NULL)
 	{
 		fprintf(stderr, "Failed to create bar process: %s\n", lemon_bin);
@@ -1394,9 +2410,6 @@ int main(int argc, char **argv)
 	for (size_t i = 0; i < state.num_blocks; ++i)
 	{
 		block = &state.blocks[i];
-		char *block_bin = cfg_get_str(&block->cfg, BLOCK_OPT_BIN);
-		char *block_cmd = block_bin ? block_bin : block->sid;
-		block->child = make_child(&state, block_cmd, 0, 1, 1);
 
 		// merge albedo (default config) with this block's config
 		for (int i = 0; i < BLOCK_OPT_COUNT; ++i)
@@ -1419,6 +2432,52 @@ int main(int argc, char **argv)
 				}
 			}
 		}
+
+		// blocks that consume their spark's output may cache the results
+		cache_init(&block->cache, cfg_has(&block->cfg, BLOCK_OPT_CACHE_SIZE) ? 
+				cfg_get_int(&block->cfg, BLOCK_OPT_CACHE_SIZE) : DEFAULT_CACHE_SIZE,
+				cfg_get_float(&block->cfg, BLOCK_OPT_CACHE) * NANOSEC_PER_SEC);
+
+		char *block_bin = cfg_get_str(&block->cfg, BLOCK_OPT_BIN);
+		char *block_cmd = block_bin ? block_bin : block->sid;
+
+		// built-in blocks don't need a child process
+		if (is_builtin(block_cmd))
+		{
+			const builtin_s *builtin = get_builtin(block_cmd);
+			if (builtin == NULL || builtin->open(&state, block) == -1)
+			{
+				fprintf(stderr, "Failed to set up built-in block '%s': %s\n", 
+						block->sid, block_cmd);
+				block->b_type = BLOCK_NONE; // never run it
+				continue;
+			}
+			block->builtin = builtin;
+			continue;
+		}
+
+		// persistent blocks get their requests via stdin
+		block->child = make_child(&state, block_cmd, block_is_persistent(block), 1, 1);
+
+		// blocks with a timeout get a process group, so all of it can be killed
+		if (block->child && block_timeout(block))
+		{
+			kita_child_set_group(block->child, 1);
+		}
+
+		// live blocks with a lot of output might want a bigger pipe
+		if (block->child && cfg_get_int(&block->cfg, BLOCK_OPT_PIPE_SIZE) > 0)
+		{
+			kita_child_set_pipe_size(block->child, cfg_get_int(&block->cfg, BLOCK_OPT_PIPE_SIZE));
+		}
+
+		// blocks are background work, they can be given a lower priority
+		kita_prio_s prio;
+		if (block->child && get_prio(&block->cfg, block->sid, &prio, 
+					BLOCK_OPT_NICE, BLOCK_OPT_SCHED, BLOCK_OPT_IOPRIO, BLOCK_OPT_AFFINITY))
+		{
+			kita_child_set_prio(block->child, &prio);
+		}
 	}
 
 	//
@@ -1443,33 +2502,38 @@ int main(int argc, char **argv)
 	// MAIN LOOP
 	//
 
-	double now;
-	//double before = get_time();
-	//double delta;
-	double wait = 0.0; 
+	// every block gets checked once right away; timed blocks will 
+	// reschedule themselves, others will be scheduled by events
+	for (size_t i = 0; i < state.num_blocks; ++i)
+	{
+		schedule_block(&state, &state.blocks[i], 0);
+	}
 
 	running = 1;
 	
 	while (running)
 	{
-		// update time (passed)
-		now    = get_time();
-		//delta  = now - before;
-		//before = now;
-
-		//fprintf(stderr, "> now = %f, wait = %f, delta = %f\n", now, wait, delta);
-
-		// open all blocks that are due for (another) invocation
-		open_due_blocks(&state, now);
+		// open all blocks that are due for (another) invocation, 
+		// feed lemon if a frame is due
+		fire_timers(&state, get_time());
 
-		// feed lemon (if the state's 'due' field is set)
-		feed_lemon(&state);
-
-		// let kita check for child events (for up to `wait` seconds)
-		kita_tick(kita, (wait == -1 ? wait : wait * MILLISEC_PER_SEC));
+		// let kita check for child events, until the next timer is due;
+		// if kita's timer can't be used, fall back to an epoll timeout
+		if (arm_timer(&state) == 0)
+		{
+			kita_tick(kita, -1);
+		}
+		else
+		{
+			kita_tick(kita, time_to_wait(&state, get_time()));
+		}
 
-		// figure out how long we can idle, based on timed blocks
-		wait = time_to_wait(&state, now);
+		// print statistics, if requested via SIGUSR1
+		if (dumping)
+		{
+			print_stats(&state, stderr);
+			dumping = 0;
+		}
 	}
 
 	//
@@ -2,6 +2,7 @@
 #define SUCCADE_H
 
 #include "libkita.h"
+#include <stdint.h> // int64_t
 #include <unistd.h> // STDOUT_FILENO, STDIN_FILENO, STDERR_FILENO
 
 #define DEBUG 0
@@ -19,8 +20,20 @@
 #define BUFFER_BLOCK_RESULT   256
 #define BUFFER_BLOCK_STR     2048
 
-#define BLOCK_WAIT_TOLERANCE 0.1
-#define MILLISEC_PER_SEC     1000
+#define DEFAULT_TIMER_SLACK  100       // in milliseconds
+#define DEFAULT_MAX_EVENTS    32       // events handled per iteration of the main loop
+#define DEFAULT_FRAME_INTERVAL 0       // in milliseconds
+#define DEFAULT_FRAME_COALESCE 0       // in milliseconds
+#define DEFAULT_FRAME_LATENCY  250     // in milliseconds
+#define DEFAULT_SPAWN        "posix_spawn"
+#define DEFAULT_MAX_RUNNING    16      // block processes at once, 0 for no limit
+#define DEFAULT_SPAWN_RATE     0       // processes per second, 0 for no limit
+#define DEFAULT_SPAWN_BURST    8       // processes in a row, despite the rate
+#define DEFAULT_TIMEOUT_GRACE  2000    // in milliseconds, from SIGTERM to SIGKILL
+#define DEFAULT_CACHE_SIZE     16      // results cached per block, if caching
+#define RUNTIME_SMOOTHING      4       // new runtime samples count 1/n towards the estimate
+#define NANOSEC_PER_SEC      1000000000LL
+#define NANOSEC_PER_MILLISEC    1000000LL
 
 #define DEFAULT_CFG_FILE "succaderc"
 
@@ -30,6 +43,22 @@
 #define DEFAULT_LEMON_NAME    "succade_lemonbar"
 #define DEFAULT_LEMON_SECTION "bar"
 
+#define BUILTIN_PREFIX        "builtin:"
+#define DEFAULT_CLOCK_FORMAT  "%H:%M"
+#define DEFAULT_CPU_FORMAT    "{usage}%"
+#define DEFAULT_MEMORY_FORMAT "{used}/{total}"
+#define DEFAULT_BATTERY_FORMAT "{capacity}%"
+#define DEFAULT_BATTERY_POLL     60    // in seconds, for capacity changes without a uevent
+#define BATTERY_SYSFS         "/sys/class/power_supply"
+#define DEFAULT_NETWORK_FORMAT "{name} {state} {ipv4}"
+#define NETWORK_MIN_SAMPLE      500    // in milliseconds, shortest span to work out rates for
+#define DEFAULT_BUILTIN_INTERVAL 1000  // in milliseconds, for built-ins without interval
+#define BUFFER_PROC_STAT_LINE  256     // a cpu line of /proc/stat is about 60 bytes
+#define BUFFER_PROC_MEMINFO   4096     // /proc/meminfo is about 1.5 KiB
+#define MEMORY_KEYS_MAX         16     // keys of /proc/meminfo a block can use
+#define BUFFER_UEVENT         8192     // a uevent is a few hundred bytes, at most 2 KiB or so
+#define BUFFER_NETWORK       16384     // rtnetlink messages, or /proc/net/dev for 100+ interfaces
+
 //
 // ENUMS
 //
@@ -57,9 +86,17 @@ enum succade_fdesc_type
 	FD_ERR = STDERR_FILENO
 };
 
+enum succade_admit_prio
+{
+	ADMIT_PRIO_URGENT,   // sparked blocks, someone is waiting for them
+	ADMIT_PRIO_NORMAL,   // timed refreshes and everything else
+	ADMIT_PRIO_COUNT
+};
+
 typedef enum succade_thing_type thing_type_e;
 typedef enum succade_block_type block_type_e;
 typedef enum succade_fdesc_type fdesc_type_e;
+typedef enum succade_admit_prio admit_prio_e;
 
 enum succade_lemon_opt
 {
@@ -81,12 +118,27 @@ enum succade_lemon_opt
 	LEMON_OPT_FG,          // -F: default foreground color
 	LEMON_OPT_LC,          // -U: underline color
 	LEMON_OPT_SEPARATOR,   // string to separate blocks with
+	LEMON_OPT_TIMER_SLACK, // int: ms that timers may fire early, to share wakeups
+	LEMON_OPT_MAX_EVENTS,  // int: max number of events handled per loop iteration
+	LEMON_OPT_FRAME_INTERVAL, // int: min ms between two frames sent to the bar
+	LEMON_OPT_FRAME_COALESCE, // int: ms to wait for further changes before a frame
+	LEMON_OPT_FRAME_LATENCY,  // int: max ms from a change to the frame showing it
+	LEMON_OPT_SPAWN,       // str: how to create child processes (fork, vfork, ...)
+	LEMON_OPT_MAX_RUNNING, // int: max number of block processes running at once
+	LEMON_OPT_SPAWN_RATE,  // float: max number of processes created per second
+	LEMON_OPT_SPAWN_BURST, // int: processes that may be created in a row anyway
+	LEMON_OPT_NICE,        // int: nice value for succade and the bar
+	LEMON_OPT_SCHED,       // str: scheduling policy (normal, batch, idle)
+	LEMON_OPT_IOPRIO,      // str: I/O class and level (idle, best-effort:4, ...)
+	LEMON_OPT_AFFINITY,    // str: CPUs to run on (0-3,6)
 	LEMON_OPT_COUNT
 };
 
 enum succade_block_opt
 {
 	BLOCK_OPT_BIN,           // string: binary
+	BLOCK_OPT_FORMAT,        // string: format for built-in blocks
+	BLOCK_OPT_INTERFACE,     // string: network interface for built-in blocks
 	BLOCK_OPT_FG,            // color: foreground
 	BLOCK_OPT_BG,            // color: background
 	BLOCK_OPT_LABEL_FG,      // color: label foreground
@@ -108,9 +160,22 @@ enum succade_block_opt
 	BLOCK_OPT_UNIT,          // string: unit
 	BLOCK_OPT_TRIGGER,       // string: trigger binary
 	BLOCK_OPT_CONSUME,       // bool: consume trigger output
+	BLOCK_OPT_CACHE,         // float: seconds to cache results for consumed output
+	BLOCK_OPT_CACHE_SIZE,    // int: number of results to cache
+	BLOCK_OPT_DEBOUNCE,      // float: seconds the trigger has to be quiet before a run
+	BLOCK_OPT_THROTTLE,      // float: min. seconds between two triggered runs
+	BLOCK_OPT_SUPERSEDE,     // bool: cancel a run when the trigger has new output
 	BLOCK_OPT_RELOAD,        // bool: reload if dead
+	BLOCK_OPT_TIMEOUT,       // float: seconds a run may take before it is killed
+	BLOCK_OPT_PRESTART,      // bool: start early, so output arrives on the interval
 	BLOCK_OPT_LIVE,          // bool: live (keeps running)
+	BLOCK_OPT_PERSISTENT,    // bool: keep running, run again via stdin
 	BLOCK_OPT_RAW,           // bool: don't escape '%'
+	BLOCK_OPT_NICE,          // int: nice value
+	BLOCK_OPT_SCHED,         // string: scheduling policy (normal, batch, idle)
+	BLOCK_OPT_IOPRIO,        // string: I/O class and level (idle, best-effort:4, ...)
+	BLOCK_OPT_AFFINITY,      // string: CPUs to run on (0-3,6)
+	BLOCK_OPT_PIPE_SIZE,     // int: size of the pipe for stdout, in bytes
 	BLOCK_OPT_CMD_LMB,       // string: run on left click
 	BLOCK_OPT_CMD_MMB,       // string: run on middle click
 	BLOCK_OPT_CMD_RMB,       // string: run on right click
@@ -129,10 +194,73 @@ typedef enum succade_block_opt block_opt_e;
 struct succade_thing;
 struct succade_prefs;
 struct succade_state;
+struct succade_timer;
+struct succade_sched;
+struct succade_stats;
 
 typedef struct succade_thing thing_s;
 typedef struct succade_prefs prefs_s;
 typedef struct succade_state state_s;
+typedef struct succade_timer timer_s;
+typedef struct succade_sched sched_s;
+typedef struct succade_stats stats_s;
+typedef struct succade_frame frame_s;
+typedef struct succade_admit admit_s;
+typedef struct succade_cache cache_s;
+typedef struct succade_cache_entry cache_entry_s;
+typedef struct succade_builtin builtin_s;
+
+typedef void (*timer_call_c)(state_s *state, timer_s *timer, int64_t now);
+
+struct succade_timer
+{
+	int64_t       due;       // deadline, in nanoseconds (CLOCK_MONOTONIC)
+	size_t        pos;       // 1-based position in the scheduler's heap, 0 if not scheduled
+	timer_call_c  call;      // function to call once the deadline is reached
+	thing_s      *thing;     // thing this timer belongs to, if any
+	unsigned char exact : 1; // never fire early, regardless of timer slack?
+};
+
+struct succade_sched
+{
+	timer_s     **heap;      // min-heap of timers, ordered by deadline
+	size_t        num;       // number of timers in the heap
+	size_t        cap;       // capacity of the heap
+};
+
+struct succade_cache_entry
+{
+	char         *key;       // consumed input
+	char         *value;     // the block's output for it
+	int64_t       stored;    // time the value was stored
+	int64_t       used;      // time the value was last stored or looked up
+};
+
+struct succade_cache
+{
+	cache_entry_s *entries;  // entries, allocated on first use
+	size_t        num;       // number of entries in use
+	size_t        cap;       // max number of entries, 0 if caching is disabled
+	int64_t       ttl;       // time entries stay valid, in nanoseconds
+};
+
+/*
+ * A provider for built-in blocks, which are rendered by succade itself, 
+ * instead of a child process. `open` sets up the block, `update` renders 
+ * the block's output into `buf` and returns the time of the next update 
+ * (0 to update as per the block's interval, -1 if there's nothing to wait
+ * for), `close` frees everything. Providers can have kita watch a file 
+ * descriptor for them, with the block as context; whenever it is readable,
+ * `event` gets to read it and returns 1 if the block should be updated now.
+ */
+struct succade_builtin
+{
+	const char *name;        // name, as in 'builtin:<name>'
+	int     (*open)(state_s *state, thing_s *block);
+	int64_t (*update)(state_s *state, thing_s *block, int64_t now, char *buf, size_t len);
+	void    (*close)(thing_s *block);
+	int     (*event)(state_s *state, thing_s *block, int fd);
+};
 
 struct succade_thing
 {
@@ -140,15 +268,80 @@ struct succade_thing
 	cfg_s         cfg;       // holds the config's options
 
 	kita_child_s *child;     // kita child process struct
+	const builtin_s *builtin;// built-in provider, instead of a child process
+	void         *data;      // the built-in provider's state
 
 	thing_type_e  t_type;    // thing type (lemon, block, spark?) 
 	block_type_e  b_type;    // block type (once, timed, sparked, live?)
-	thing_s      *other;     // associated block (for sparks) or spark (for blocks) 
+	thing_s      *other;     // associated spark (for blocks)
+	thing_s     **subs;      // blocks fed by this spark (for sparks)
+	size_t        num_subs;  // number of blocks fed by this spark
 
 	char         *output;    // last output from stdout
+	char         *pending;   // spark output waiting to be handled, if any
+	char         *input;     // spark output consumed by the current run, if any
+	cache_s       cache;     // results for consumed spark output, if enabled
 	unsigned char alive : 1; // is up and running?
-	double        last_open; // timestamp (in seconds) of last open operation
-	double        last_read; // timestamp (in seconds) of last read operation
+	unsigned char overdue : 1; // became due while still running?
+	unsigned char busy : 1;  // persistent block: waiting for its answer?
+	unsigned char overrun : 1; // timed out, has been sent SIGTERM already?
+	unsigned char superseded : 1; // cancelled, as its input is out of date?
+	unsigned char timing : 1;  // waiting for the run's first output, to time it?
+	int64_t       last_open; // timestamp (in nanoseconds) of last open operation (or tick)
+	int64_t       last_read; // timestamp (in nanoseconds) of last read operation
+	int64_t       runtime;   // estimated time from (re)start to output, 0 if unknown
+	int64_t       boundary;  // interval boundary the next run is for (timed blocks)
+	timer_s       timer;     // next scheduled run, if any
+	timer_s       deadline;  // timeout of the current run, if any
+	thing_s      *queue_next;// next block waiting for admission
+	int64_t       queued;    // time the block was queued for admission, 0 if not
+	admit_prio_e  queue_prio;// priority it was queued with
+};
+
+struct succade_stats
+{
+	unsigned long wakeups;   // number of timer wakeups
+	unsigned long coalesced; // timers that fired early, sharing a wakeup
+	unsigned long frames;    // number of frames sent to the bar
+	unsigned long merged;    // changes that went into an already pending frame
+	unsigned long timeouts;  // block runs that took longer than their timeout
+	unsigned long kills;     // of those, the ones that had to be killed
+	unsigned long queued;    // block runs that had to wait for admission
+	size_t        max_queued;// most blocks waiting for admission at once
+	int64_t       wait_sum;  // total time blocks waited for admission
+	int64_t       wait_max;  // longest time a block waited for admission
+	unsigned long cache_hits;   // runs saved by the result cache
+	unsigned long cache_misses; // runs despite the result cache
+	unsigned long sparked;   // trigger output handed to blocks
+	unsigned long skipped;   // of those, replaced by newer output before a run
+	unsigned long cancelled; // runs cancelled due to newer trigger output
+	unsigned long builtins;  // updates of built-in blocks (runs without a process)
+	unsigned long notified;  // events that built-in blocks were notified of
+};
+
+struct succade_frame
+{
+	int64_t  first;          // time of the first change not yet sent, 0 if none
+	int64_t  last;           // time of the most recent change
+	int64_t  sent;           // time the last frame was sent
+	int64_t  interval;       // min time between two frames, in nanoseconds
+	int64_t  coalesce;       // time to wait for further changes, in nanoseconds
+	int64_t  latency;        // max time from first change to frame, in nanoseconds
+	timer_s  timer;          // deadline for the pending frame, if any
+};
+
+struct succade_admit
+{
+	int      max_running;    // max number of block processes at once, 0 if no limit
+	int      running;        // number of block processes currently running
+	double   rate;           // new processes per second, 0 if no limit
+	double   burst;          // max number of tokens (processes in a row)
+	double   tokens;         // processes that may be created right now
+	int64_t  refilled;       // time the tokens were last refilled
+	thing_s *head[ADMIT_PRIO_COUNT]; // blocks waiting for admission, per priority
+	thing_s *tail[ADMIT_PRIO_COUNT];
+	size_t   num_queued;     // number of blocks waiting
+	timer_s  timer;          // wakeup for when the next token is available
 };
 
 struct succade_prefs
@@ -178,7 +371,12 @@ struct succade_state
 	size_t   num_blocks;     // Number of blocks in blocks array
 	size_t   num_sparks;     // Number of sparks in sparks array
 	kita_state_s *kita;
-	unsigned char due : 1;
+	sched_s  sched;          // timers, ordered by deadline
+	int64_t  slack;          // timer slack, in nanoseconds
+	int64_t  armed;          // deadline the kita timer is armed for, -1 if none
+	stats_s  stats;          // counters, for diagnostics
+	frame_s  frame;          // render scheduling for the bar
+	admit_s  admit;          // admission control for block processes
 	block_t *real_blocks;
 };
 
@@ -0,0 +1,93 @@
+#define KITA_IMPLEMENTATION
+#define _GNU_SOURCE
+
+#include <stdlib.h>  // NULL, strtol()
+#include <string.h>  // strlen(), strncat()
+#include <unistd.h>  // dup(), close()
+#include <fcntl.h>   // open(), O_RDONLY
+#include "../src/libkita.h"
+#include "test.h"
+
+/*
+ * Children created by any of the spawn backends get to see nothing but their
+ * std streams: not the pipes of other children, nor any other fd of ours,
+ * whether it was opened with O_CLOEXEC or not. Checked by having each one
+ * list its open file descriptors, of which `ls` has one more: the directory
+ * it is listing.
+ */
+
+static char listing[1024];
+static int  reaped;
+
+static void on_readok(kita_state_s *state, kita_event_s *event)
+{
+	const char *data = kita_child_read(event->child, event->ios);
+	if (data)
+	{
+		strncat(listing, data, sizeof(listing) - strlen(listing) - 1);
+	}
+}
+
+static void on_reaped(kita_state_s *state, kita_event_s *event)
+{
+	reaped = 1;
+}
+
+static void test_spawn(kita_spawn_type_e spawn)
+{
+	kita_state_s *state = kita_init();
+	CHECK(state != NULL);
+	CHECK(kita_set_spawn(state, spawn) == 0);
+	kita_set_callback(state, KITA_EVT_CHILD_READOK, on_readok);
+	kita_set_callback(state, KITA_EVT_CHILD_REAPED, on_reaped);
+
+	kita_child_s *child = kita_child_new("ls -1 /proc/self/fd", 1, 1, 1);
+	kita_child_set_buf_type(child, KITA_IOS_OUT, KITA_BUF_FULL);
+	kita_child_add(state, child);
+
+	listing[0] = '\0';
+	reaped = 0;
+	CHECK(kita_child_open(child) == 0);
+	for (int i = 0; i < 100 && !reaped; ++i)
+	{
+		kita_tick(state, 100);
+	}
+	CHECK(reaped);
+
+	// all there should be is 0, 1, 2 and the directory ls is listing
+	int num = 0;
+	for (char *line = strtok(listing, "\n"); line; line = strtok(NULL, "\n"))
+	{
+		int fd = strtol(line, NULL, 10);
+		if (fd > 3)
+		{
+			fprintf(stderr, "spawn type %d: child inherited fd %d\n", spawn, fd);
+		}
+		CHECK(fd <= 3);
+		++num;
+	}
+	CHECK(num == 4);
+
+	kita_free(&state);
+}
+
+int main()
+{
+	// fds the children shouldn't get, with and without close-on-exec
+	int fds[] = {
+		open("/dev/null", O_RDONLY),
+		open("/dev/null", O_RDONLY | O_CLOEXEC),
+		dup(STDERR_FILENO)
+	};
+
+	for (int spawn = KITA_SPAWN_FORK; spawn < KITA_SPAWN_COUNT; ++spawn)
+	{
+		test_spawn(spawn);
+	}
+
+	for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); ++i)
+	{
+		close(fds[i]);
+	}
+	return TEST_RESULT();
+}
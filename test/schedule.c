@@ -0,0 +1,125 @@
+#define main succade_main
+#include "../src/succade.c"
+#undef main
+
+#include "test.h"
+
+/*
+ * The scheduler (min-heap of timers) and fire_timers(): timers come out in
+ * order of their deadlines, and a timer that is long overdue fires once and
+ * is then rescheduled from now, instead of being replayed for every interval
+ * that was missed.
+ */
+
+static int calls = 0;
+
+// does what open_block() does for timed blocks: schedule the next run
+static void on_timer_reschedule(state_s *state, timer_s *timer, int64_t now)
+{
+	++calls;
+	sched_add(&state->sched, timer, block_next_run(timer->thing, now));
+}
+
+static void on_timer_count(state_s *state, timer_s *timer, int64_t now)
+{
+	++calls;
+}
+
+// timers come out ordered by deadline, also after some have been moved
+static void test_heap_order()
+{
+	sched_s sched = { 0 };
+	timer_s timers[100] = { 0 };
+
+	unsigned seed = 42;
+	for (size_t i = 0; i < 100; ++i)
+	{
+		seed = seed * 1103515245 + 12345;
+		sched_add(&sched, &timers[i], (seed >> 8) % 10000);
+	}
+	for (size_t i = 0; i < 100; i += 3)
+	{
+		sched_add(&sched, &timers[i], timers[i].due / 2);
+	}
+	for (size_t i = 1; i < 100; i += 7)
+	{
+		sched_del(&sched, &timers[i]);
+		CHECK(!timer_is_set(&timers[i]));
+	}
+
+	int64_t last = -1;
+	size_t  num  = 0;
+	timer_s *timer;
+	while ((timer = sched_pop(&sched, INT64_MAX)))
+	{
+		CHECK(timer->due >= last);
+		last = timer->due;
+		++num;
+	}
+	CHECK(num == 100 - 15);
+	sched_free(&sched);
+}
+
+// a timer ten intervals overdue fires once, then is due in the future
+static void test_overdue()
+{
+	state_s state = { 0 };
+	thing_s block = { 0 };
+	cfg_init(&block.cfg, "overdue", BLOCK_OPT_COUNT);
+	cfg_set_float(&block.cfg, BLOCK_OPT_RELOAD, 1.0);
+
+	int64_t now = get_time();
+	block.timer = (timer_s) { .call = on_timer_reschedule, .thing = &block };
+	sched_add(&state.sched, &block.timer, now - 10 * NANOSEC_PER_SEC);
+	CHECK(sched_wait(&state.sched, now) == 0);
+
+	calls = 0;
+	CHECK(fire_timers(&state, now) == 1);
+	CHECK(calls == 1);
+	CHECK(timer_is_set(&block.timer));
+	CHECK(block.timer.due > now);
+	CHECK(block.timer.due <= now + NANOSEC_PER_SEC);
+
+	// nothing left to catch up on, and the wait is neither 0 nor endless
+	CHECK(fire_timers(&state, now) == 0);
+	CHECK(calls == 1);
+	int wait = sched_wait(&state.sched, now);
+	CHECK(wait > 0 && wait <= 1000);
+
+	sched_free(&state.sched);
+	cfg_free(&block.cfg);
+}
+
+// timers within the slack fire along, exact ones don't, nor those behind them
+static void test_slack()
+{
+	state_s state = { .slack = 100 * NANOSEC_PER_MILLISEC };
+	timer_s soon  = { .call = on_timer_count };
+	timer_s exact = { .call = on_timer_count, .exact = 1 };
+	timer_s later = { .call = on_timer_count };
+
+	int64_t now = 1000 * NANOSEC_PER_SEC;
+	sched_add(&state.sched, &soon,  now + 50 * NANOSEC_PER_MILLISEC);
+	sched_add(&state.sched, &exact, now + 60 * NANOSEC_PER_MILLISEC);
+	sched_add(&state.sched, &later, now + 70 * NANOSEC_PER_MILLISEC);
+
+	calls = 0;
+	CHECK(fire_timers(&state, now) == 1);
+	CHECK(!timer_is_set(&soon));
+	CHECK(timer_is_set(&exact) && timer_is_set(&later));
+	CHECK(sched_wait(&state.sched, now) == 60);
+
+	CHECK(fire_timers(&state, now + 60 * NANOSEC_PER_MILLISEC) == 2);
+	CHECK(calls == 3);
+	CHECK(sched_wait(&state.sched, now) == -1);
+
+	sched_free(&state.sched);
+}
+
+int main()
+{
+	test_heap_order();
+	test_overdue();
+	test_slack();
+	return TEST_RESULT();
+}
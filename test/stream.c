@@ -0,0 +1,126 @@
+#define KITA_IMPLEMENTATION
+#define _GNU_SOURCE
+
+#include <stdlib.h>  // NULL, malloc(), free()
+#include <string.h>  // memset(), strlen(), strcmp()
+#include <unistd.h>  // pipe2(), write(), close()
+#include <fcntl.h>   // O_NONBLOCK
+#include "../src/libkita.h"
+#include "test.h"
+
+/*
+ * Line reading of libkita's streams, at and around the size of the read
+ * buffer: the stream must never grow past its buffer, overlong lines are
+ * dropped, and the next line after one of those comes through intact.
+ */
+
+// writes `len` times 'x', then a newline, then `tail` (if not NULL)
+static void feed(int fd, size_t len, const char *tail)
+{
+	char *buf = malloc(len + 1);
+	memset(buf, 'x', len);
+	buf[len] = '\n';
+	CHECK(write(fd, buf, len + 1) == (ssize_t) (len + 1));
+	if (tail)
+	{
+		CHECK(write(fd, tail, strlen(tail)) == (ssize_t) strlen(tail));
+	}
+	free(buf);
+}
+
+// sets up a line buffered stream that reads from the read end of a new pipe
+static void stream_open(kita_stream_s *stream, int *wfd)
+{
+	int fds[2];
+	CHECK(pipe2(fds, O_NONBLOCK) == 0);
+	memset(stream, 0, sizeof(kita_stream_s));
+	stream->fd       = fds[0];
+	stream->buf_type = KITA_BUF_LINE;
+	*wfd = fds[1];
+}
+
+static void stream_done(kita_stream_s *stream, int wfd)
+{
+	close(stream->fd);
+	close(wfd);
+	free(stream->buf);
+}
+
+// a line whose newline is the last byte that fits the buffer
+static void test_line_at_capacity()
+{
+	kita_stream_s stream;
+	int wfd;
+	stream_open(&stream, &wfd);
+
+	feed(wfd, KITA_BUFFER_SIZE - 2, NULL);
+	CHECK(libkita_stream_read_line(&stream, 1) == NULL);
+	CHECK(stream.len < KITA_BUFFER_SIZE - 1);
+
+	feed(wfd, 0, "next\n");
+	const char *line = libkita_stream_read_line(&stream, 1);
+	CHECK(line && strcmp(line, "next") == 0);
+
+	stream_done(&stream, wfd);
+}
+
+// the longest line that is kept, and the shortest one that isn't
+static void test_longest_line()
+{
+	kita_stream_s stream;
+	int wfd;
+	stream_open(&stream, &wfd);
+
+	feed(wfd, KITA_BUFFER_SIZE - 5, NULL);
+	const char *line = libkita_stream_read_line(&stream, 1);
+	CHECK(line && strlen(line) == KITA_BUFFER_SIZE - 5);
+
+	feed(wfd, KITA_BUFFER_SIZE - 4, NULL);
+	CHECK(libkita_stream_read_line(&stream, 1) == NULL);
+	CHECK(stream.len < KITA_BUFFER_SIZE - 1);
+
+	stream_done(&stream, wfd);
+}
+
+// a line that is longer than the buffer, followed by a short one
+static void test_overlong_line()
+{
+	kita_stream_s stream;
+	int wfd;
+	stream_open(&stream, &wfd);
+
+	feed(wfd, KITA_BUFFER_SIZE * 3, "short\n");
+	const char *line = libkita_stream_read_line(&stream, 0);
+	CHECK(line && strcmp(line, "short\n") == 0);
+
+	stream_done(&stream, wfd);
+}
+
+// an incomplete last line that fills the buffer when the writer goes away
+static void test_eof_at_capacity()
+{
+	kita_stream_s stream;
+	int wfd;
+	stream_open(&stream, &wfd);
+
+	char buf[KITA_BUFFER_SIZE];
+	memset(buf, 'x', sizeof(buf));
+	CHECK(write(wfd, buf, KITA_BUFFER_SIZE - 3) == KITA_BUFFER_SIZE - 3);
+	close(wfd);
+
+	const char *line = libkita_stream_read_line(&stream, 1);
+	CHECK(line && strlen(line) == KITA_BUFFER_SIZE - 3);
+	CHECK(stream.len < KITA_BUFFER_SIZE);
+
+	close(stream.fd);
+	free(stream.buf);
+}
+
+int main()
+{
+	test_line_at_capacity();
+	test_longest_line();
+	test_overlong_line();
+	test_eof_at_capacity();
+	return TEST_RESULT();
+}
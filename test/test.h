@@ -0,0 +1,28 @@
+#ifndef SUCCADE_TEST_H
+#define SUCCADE_TEST_H
+
+#include <stdio.h>  // fprintf(), stderr
+
+/*
+ * Minimal helpers for the tests: every test is a program of its own, built
+ * and run by test/run, that returns 0 if all of its checks passed.
+ */
+
+static int test_failed = 0;
+
+// check a condition, report the line if it doesn't hold, but carry on
+#define CHECK(cond) \
+	do \
+	{ \
+		if (!(cond)) \
+		{ \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			test_failed = 1; \
+		} \
+	} \
+	while (0)
+
+// to be returned from main()
+#define TEST_RESULT() (test_failed ? 1 : 0)
+
+#endif